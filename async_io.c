@@ -0,0 +1,435 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "async_io.h"
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#else
+#define HAVE_IO_URING 0
+#endif
+
+#if defined(__linux__) && defined(SYS_futex) && __has_include(<linux/futex.h>)
+#include <linux/futex.h>
+#define HAVE_FUTEX 1
+#else
+#define HAVE_FUTEX 0
+#endif
+
+/*
+ * Async I/O Engine
+ * ----------------
+ * Request states: IDLE -> PENDING (submitted) -> DONE, with SLEEPING as a
+ * PENDING that a thread waits on. The state is a wait word: a waiter sleeps
+ * on the request's own futex, and a completion wakes it only if the state
+ * it replaces is SLEEPING, so a completion never wakes the waiters of other
+ * requests and costs no system call when nobody waits. `inflight` counts
+ * requests in flight and is bounded by `depth`; every completion decrements
+ * it under `lock`, and broadcasts `cond` only when a submitter waiting for
+ * room (or ioe_free) sleeps there.
+ *
+ * io_uring: the rings are mapped once at init. Submitters serialize on
+ * sqLock to fill SQEs and publish the tail; the reaper thread alone owns the
+ * CQ head. A NOP with user_data 0 tells the reaper to exit. CQ overflow
+ * cannot happen: the CQ ring has twice the SQ entries and at most `depth`
+ * (<= SQ entries) requests are ever in flight.
+ *
+ * Threads: submitted requests go on a FIFO queue that the workers drain with
+ * readBlock/writeBlock, which are safe to run concurrently on one handle. A
+ * worker takes the queued requests that continue its request's page run
+ * (same op, next page) along with it and moves them with one readBlocks/
+ * writeBlocks call, so a submitted batch of adjacent pages is one syscall.
+ */
+
+enum { IO_IDLE = 0, IO_PENDING = 1, IO_DONE = 2, IO_SLEEPING = 3 };
+
+#define IOE_DEFAULT_DEPTH   64
+#define IOE_DEFAULT_WORKERS 4
+#define IOE_MAX_RUN         32   /* requests one worker moves in a single call */
+
+struct IOEngine {
+    SM_FileHandle  *fh;
+    IOBackend       backend;
+    int             depth;
+
+    pthread_mutex_t lock;      /* inflight, worker queue, stopping */
+    pthread_cond_t  cond;      /* a request completed, freeing a slot */
+    int             inflight;
+    int             sleepers;  /* threads waiting on cond */
+    bool            stopping;
+
+    /* io_uring */
+    int             ringFd;
+    void           *sqPtr, *cqPtr;
+    size_t          sqSize, cqSize;
+    void           *sqes;
+    size_t          sqesSize;
+    unsigned       *sqTail, *sqMask, *sqArray;
+    unsigned       *cqHead, *cqTail, *cqMask;
+    void           *cqes;
+    pthread_mutex_t sqLock;
+    pthread_t       reaper;
+    bool            reaperStarted;
+
+    /* threads */
+    IORequest      *qHead, *qTail;
+    pthread_cond_t  workCond;
+    pthread_t      *workers;
+    int             numWorkers;
+};
+
+/* ------------ Wait words ------------ */
+
+#if HAVE_FUTEX
+static void futex_wait(atomic_int *w, int val) {
+    (void)syscall(SYS_futex, (int *)w, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);   /* EAGAIN, EINTR: the caller looks again */
+}
+
+static void futex_wake(atomic_int *w) {
+    (void)syscall(SYS_futex, (int *)w, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+#else
+static void futex_wait(atomic_int *w, int val) { (void)w; (void)val; sched_yield(); }
+static void futex_wake(atomic_int *w) { (void)w; }
+#endif
+
+void ioe_waitWord(atomic_int *w, int busy, int sleeping) {
+    int v = atomic_load_explicit(w, memory_order_acquire);
+    while (v == busy || v == sleeping) {
+        if (v == busy && !atomic_compare_exchange_weak_explicit(w, &v, sleeping, memory_order_acquire, memory_order_acquire))
+            continue;
+        futex_wait(w, sleeping);
+        v = atomic_load_explicit(w, memory_order_acquire);
+    }
+}
+
+void ioe_setWord(atomic_int *w, int value, int sleeping) {
+    /* the word may be released as soon as it changes; waking a stale address at worst makes a waiter look again */
+    if (atomic_exchange_explicit(w, value, memory_order_acq_rel) == sleeping) futex_wake(w);
+}
+
+/* ------------ Completion ------------ */
+
+static void complete(IOEngine *e, IORequest *r, RC rc) {
+    r->rc = rc;
+    if (r->done) {
+        /* nobody waits on a request with a callback, which may release it: do not touch r afterwards */
+        atomic_store(&r->state, IO_DONE);
+        r->done(r);
+    } else {
+        ioe_setWord(&r->state, IO_DONE, IO_SLEEPING);   /* its waiter may release r from here on */
+    }
+    pthread_mutex_lock(&e->lock);
+    e->inflight--;
+    if (e->sleepers > 0) pthread_cond_broadcast(&e->cond);
+    pthread_mutex_unlock(&e->lock);
+}
+
+static void wait_for_slot(IOEngine *e) {
+    e->sleepers++;
+    pthread_cond_wait(&e->cond, &e->lock);
+    e->sleepers--;
+}
+
+/* Take up to `want` in-flight slots, waiting while the engine is at its depth */
+static int reserve(IOEngine *e, int want) {
+    pthread_mutex_lock(&e->lock);
+    while (e->inflight >= e->depth) wait_for_slot(e);
+    int take = (e->depth - e->inflight < want) ? e->depth - e->inflight : want;
+    e->inflight += take;
+    pthread_mutex_unlock(&e->lock);
+    return take;
+}
+
+static RC sync_transfer(IOEngine *e, IORequest *r) {
+    return (r->op == IO_READ) ? readBlock(r->pageNum, e->fh, r->buf) : writeBlock(r->pageNum, e->fh, r->buf);
+}
+
+static RC op_error(IORequest *r) {
+    return (r->op == IO_READ) ? RC_READ_NON_EXISTING_PAGE : RC_WRITE_FAILED;
+}
+
+/* ------------ io_uring backend ------------ */
+
+#if HAVE_IO_URING
+
+static int uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static void *uring_reaper(void *arg) {
+    IOEngine *e = arg;
+    struct io_uring_cqe *cqes = e->cqes;
+    bool stop = FALSE;
+    while (!stop) {
+        unsigned head = *e->cqHead;
+        unsigned tail = __atomic_load_n(e->cqTail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            (void)uring_enter(e->ringFd, 0, 1, IORING_ENTER_GETEVENTS);   /* EINTR: just look again */
+            continue;
+        }
+        for (; head != tail; head++) {
+            struct io_uring_cqe *cqe = &cqes[head & *e->cqMask];
+            IORequest *r = (IORequest *)(uintptr_t)cqe->user_data;
+            int res = cqe->res;
+            __atomic_store_n(e->cqHead, head + 1, __ATOMIC_RELEASE);
+            if (!r) { stop = TRUE; continue; }
+            /* pair with uring_push's PENDING store: the hand-over went through the kernel, which C11 ordering does not see */
+            (void)atomic_load_explicit(&r->state, memory_order_acquire);
+            if (res == PAGE_SIZE) complete(e, r, RC_OK);
+            else if (res < 0) complete(e, r, op_error(r));
+            else complete(e, r, sync_transfer(e, r));   /* short transfer: redo it the blocking way */
+        }
+    }
+    return NULL;
+}
+
+/* Queue SQEs for reqs (slots already reserved) and hand them to the kernel */
+static void uring_push(IOEngine *e, IORequest **reqs, int n) {
+    struct io_uring_sqe *sqes = e->sqes;
+    int fd = getFileDescriptor(e->fh);
+    pthread_mutex_lock(&e->sqLock);
+    unsigned tail = *e->sqTail;
+    for (int i = 0; i < n; i++, tail++) {
+        unsigned idx = tail & *e->sqMask;
+        struct io_uring_sqe *sqe = &sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        if (reqs[i]) {
+            IORequest *r = reqs[i];
+            r->iov.iov_base = r->buf;
+            r->iov.iov_len = PAGE_SIZE;
+            sqe->opcode = (r->op == IO_READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->fd = fd;
+            sqe->off = (unsigned long long)r->pageNum * PAGE_SIZE;
+            sqe->addr = (unsigned long long)(uintptr_t)&r->iov;
+            sqe->len = 1;
+            sqe->user_data = (unsigned long long)(uintptr_t)r;
+            atomic_store_explicit(&r->state, IO_PENDING, memory_order_release);   /* hand-over point for the reaper */
+        } else {
+            sqe->opcode = IORING_OP_NOP;   /* user_data 0: stop the reaper */
+        }
+        e->sqArray[idx] = idx;
+    }
+    __atomic_store_n(e->sqTail, tail, __ATOMIC_RELEASE);
+    for (int left = n; left > 0;) {
+        int done = uring_enter(e->ringFd, (unsigned)left, 0, 0);
+        if (done > 0) left -= done;
+        else if (done < 0 && errno != EINTR) sched_yield();   /* EAGAIN/EBUSY: the kernel is short of resources */
+    }
+    pthread_mutex_unlock(&e->sqLock);
+}
+
+static RC uring_init(IOEngine *e) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    e->ringFd = (int)syscall(__NR_io_uring_setup, (unsigned)e->depth, &p);
+    if (e->ringFd < 0) return RC_FILE_HANDLE_NOT_INIT;
+    if ((int)p.sq_entries < e->depth) e->depth = (int)p.sq_entries;
+
+    e->sqSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    e->cqSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) e->sqSize = e->cqSize = (e->sqSize > e->cqSize) ? e->sqSize : e->cqSize;
+
+    e->sqPtr = mmap(NULL, e->sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->ringFd, IORING_OFF_SQ_RING);
+    if (e->sqPtr == MAP_FAILED) { e->sqPtr = NULL; return RC_FILE_HANDLE_NOT_INIT; }
+    e->cqPtr = single ? e->sqPtr
+                      : mmap(NULL, e->cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->ringFd, IORING_OFF_CQ_RING);
+    if (e->cqPtr == MAP_FAILED) { e->cqPtr = NULL; return RC_FILE_HANDLE_NOT_INIT; }
+    e->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    e->sqes = mmap(NULL, e->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, e->ringFd, IORING_OFF_SQES);
+    if (e->sqes == MAP_FAILED) { e->sqes = NULL; return RC_FILE_HANDLE_NOT_INIT; }
+
+    char *sq = e->sqPtr, *cq = e->cqPtr;
+    e->sqTail = (unsigned *)(sq + p.sq_off.tail);
+    e->sqMask = (unsigned *)(sq + p.sq_off.ring_mask);
+    e->sqArray = (unsigned *)(sq + p.sq_off.array);
+    e->cqHead = (unsigned *)(cq + p.cq_off.head);
+    e->cqTail = (unsigned *)(cq + p.cq_off.tail);
+    e->cqMask = (unsigned *)(cq + p.cq_off.ring_mask);
+    e->cqes = cq + p.cq_off.cqes;
+
+    if (pthread_create(&e->reaper, NULL, uring_reaper, e) != 0) return RC_FILE_HANDLE_NOT_INIT;
+    e->reaperStarted = TRUE;
+    return RC_OK;
+}
+
+static void uring_free(IOEngine *e) {
+    if (e->reaperStarted) {
+        IORequest *stop = NULL;
+        uring_push(e, &stop, 1);
+        pthread_join(e->reaper, NULL);
+    }
+    if (e->sqes) munmap(e->sqes, e->sqesSize);
+    if (e->cqPtr && e->cqPtr != e->sqPtr) munmap(e->cqPtr, e->cqSize);
+    if (e->sqPtr) munmap(e->sqPtr, e->sqSize);
+    if (e->ringFd >= 0) close(e->ringFd);
+}
+
+#else
+
+static RC uring_init(IOEngine *e) { (void)e; return RC_FILE_HANDLE_NOT_INIT; }
+static void uring_free(IOEngine *e) { (void)e; }
+static void uring_push(IOEngine *e, IORequest **reqs, int n) { (void)e; (void)reqs; (void)n; }
+
+#endif
+
+/* ------------ Thread-pool backend ------------ */
+
+/* Move a run of requests for consecutive pages in one call; if that fails, retry one by one for individual results */
+static void run_transfer(IOEngine *e, IORequest **run, int n) {
+    if (n > 1) {
+        SM_PageHandle bufs[IOE_MAX_RUN];
+        for (int i = 0; i < n; i++) bufs[i] = run[i]->buf;
+        RC rc = (run[0]->op == IO_READ) ? readBlocks(run[0]->pageNum, n, e->fh, bufs) : writeBlocks(run[0]->pageNum, n, e->fh, bufs);
+        if (rc == RC_OK) {
+            for (int i = 0; i < n; i++) complete(e, run[i], RC_OK);
+            return;
+        }
+    }
+    for (int i = 0; i < n; i++) complete(e, run[i], sync_transfer(e, run[i]));
+}
+
+static void *worker_main(void *arg) {
+    IOEngine *e = arg;
+    IORequest *run[IOE_MAX_RUN];
+    for (;;) {
+        pthread_mutex_lock(&e->lock);
+        while (!e->qHead && !e->stopping) pthread_cond_wait(&e->workCond, &e->lock);
+        if (!e->qHead) { pthread_mutex_unlock(&e->lock); return NULL; }   /* stopping and drained */
+        int n = 0;
+        do {
+            run[n++] = e->qHead;
+            e->qHead = e->qHead->next;
+        } while (n < IOE_MAX_RUN && e->qHead && e->qHead->op == run[0]->op && e->qHead->pageNum == run[n - 1]->pageNum + 1);
+        if (!e->qHead) e->qTail = NULL;
+        pthread_mutex_unlock(&e->lock);
+        run_transfer(e, run, n);
+    }
+}
+
+static RC threads_init(IOEngine *e, int workers) {
+    e->workers = calloc((size_t)workers, sizeof(pthread_t));
+    if (!e->workers) return RC_WRITE_FAILED;
+    for (; e->numWorkers < workers; e->numWorkers++)
+        if (pthread_create(&e->workers[e->numWorkers], NULL, worker_main, e) != 0) return RC_WRITE_FAILED;
+    return RC_OK;
+}
+
+static void threads_free(IOEngine *e) {
+    pthread_mutex_lock(&e->lock);
+    e->stopping = TRUE;
+    pthread_cond_broadcast(&e->workCond);
+    pthread_mutex_unlock(&e->lock);
+    for (int i = 0; i < e->numWorkers; i++) pthread_join(e->workers[i], NULL);
+    free(e->workers);
+}
+
+static void threads_push(IOEngine *e, IORequest **reqs, int n) {
+    pthread_mutex_lock(&e->lock);
+    for (int i = 0; i < n; i++) {
+        reqs[i]->next = NULL;
+        if (e->qTail) e->qTail->next = reqs[i]; else e->qHead = reqs[i];
+        e->qTail = reqs[i];
+    }
+    pthread_cond_broadcast(&e->workCond);
+    pthread_mutex_unlock(&e->lock);
+}
+
+/* ------------ Public API ------------ */
+
+RC ioe_init(IOEngine **out, SM_FileHandle *fh, IOBackend backend, int depth, int workers) {
+    if (!out || getFileDescriptor(fh) < 0 || depth < 0 || workers < 0) return RC_FILE_HANDLE_NOT_INIT;
+    IOEngine *e = calloc(1, sizeof(IOEngine));
+    if (!e) return RC_WRITE_FAILED;
+    e->fh = fh;
+    e->depth = depth ? depth : IOE_DEFAULT_DEPTH;
+    e->ringFd = -1;
+    pthread_mutex_init(&e->lock, NULL);
+    pthread_mutex_init(&e->sqLock, NULL);
+    pthread_cond_init(&e->cond, NULL);
+    pthread_cond_init(&e->workCond, NULL);
+
+    RC rc = RC_FILE_HANDLE_NOT_INIT;
+    if (backend != IO_BACKEND_THREADS) {
+        rc = uring_init(e);
+        if (rc == RC_OK) e->backend = IO_BACKEND_URING;
+        else { uring_free(e); e->ringFd = -1; e->sqPtr = e->cqPtr = e->sqes = NULL; }
+    }
+    if (rc != RC_OK && backend != IO_BACKEND_URING) {
+        e->depth = depth ? depth : IOE_DEFAULT_DEPTH;
+        rc = threads_init(e, workers ? workers : IOE_DEFAULT_WORKERS);
+        e->backend = IO_BACKEND_THREADS;
+    }
+    if (rc != RC_OK) {
+        ioe_free(e);
+        return rc;
+    }
+    *out = e;
+    return RC_OK;
+}
+
+void ioe_free(IOEngine *e) {
+    if (!e) return;
+    pthread_mutex_lock(&e->lock);
+    while (e->inflight > 0) wait_for_slot(e);
+    pthread_mutex_unlock(&e->lock);
+    if (e->backend == IO_BACKEND_URING) uring_free(e);
+    else threads_free(e);
+    pthread_cond_destroy(&e->workCond);
+    pthread_cond_destroy(&e->cond);
+    pthread_mutex_destroy(&e->sqLock);
+    pthread_mutex_destroy(&e->lock);
+    free(e);
+}
+
+IOBackend ioe_backend(IOEngine *e) {
+    return e->backend;
+}
+
+/* Requests come from an array (reqs) or an array of pointers (ptrs) */
+static void submit(IOEngine *e, IORequest *reqs, IORequest **ptrs, int n) {
+    IORequest *batch[IOE_DEFAULT_DEPTH];
+    int i = 0;
+    while (i < n) {
+        int take = reserve(e, (n - i < IOE_DEFAULT_DEPTH) ? n - i : IOE_DEFAULT_DEPTH);
+        int valid = 0;
+        int pages = getTotalNumPages(e->fh);
+        for (int k = 0; k < take; k++, i++) {
+            IORequest *r = ptrs ? ptrs[i] : &reqs[i];
+            atomic_store(&r->state, IO_PENDING);
+            if (!r->buf || r->pageNum < 0 || r->pageNum >= pages) complete(e, r, r->buf ? op_error(r) : RC_FILE_HANDLE_NOT_INIT);
+            else batch[valid++] = r;
+        }
+        if (valid == 0) continue;
+        if (e->backend == IO_BACKEND_URING) uring_push(e, batch, valid);
+        else threads_push(e, batch, valid);
+    }
+}
+
+void ioe_submit(IOEngine *e, IORequest *reqs, int n) {
+    submit(e, reqs, NULL, n);
+}
+
+void ioe_submitv(IOEngine *e, IORequest **reqs, int n) {
+    submit(e, NULL, reqs, n);
+}
+
+bool ioe_done(IORequest *req) {
+    return atomic_load(&req->state) == IO_DONE;
+}
+
+RC ioe_wait(IOEngine *e, IORequest *req) {
+    (void)e;
+    ioe_waitWord(&req->state, IO_PENDING, IO_SLEEPING);
+    return req->rc;
+}
@@ -0,0 +1,81 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <stdatomic.h>
+#include <sys/uio.h>
+#include "storage_mgr.h"
+#include "dt.h"
+
+/*
+ * IOEngine — asynchronous page reads and writes on an open SM_FileHandle.
+ * ------------------------------------------------------------
+ * A caller fills in IORequests, submits them and later waits for them (or
+ * lets a completion callback run), so it can drop its latches while the
+ * transfer is in flight. Two backends:
+ *  - io_uring (Linux 5.1+), driven through the raw system calls; a
+ *    completion thread reaps the ring, runs callbacks and wakes waiters.
+ *  - a pool of worker threads doing readBlock/writeBlock, used where
+ *    io_uring is unavailable (old kernel, disabled by policy) or requested.
+ * At most `depth` requests are in flight; submitting more blocks until some
+ * complete. A request must stay valid, and its buffer untouched, until it
+ * has completed.
+ * The buffer pool submits only its read-ahead (prefetchPages and the
+ * sequential-scan window) here; a miss read and a dirty-victim write-back
+ * go straight to storage_mgr (through the doublewrite file when there is
+ * one), since their caller waits for them anyway.
+ */
+
+typedef enum IOBackend {
+	IO_BACKEND_AUTO = 0,     /* io_uring if the kernel allows it, else threads */
+	IO_BACKEND_URING = 1,
+	IO_BACKEND_THREADS = 2
+} IOBackend;
+
+typedef enum IOOp {
+	IO_READ = 0,
+	IO_WRITE = 1
+} IOOp;
+
+typedef struct IORequest IORequest;
+struct IORequest {
+    IOOp        op;
+    int         pageNum;
+    char       *buf;          /* PAGE_SIZE bytes */
+    void      (*done)(IORequest *req);  /* optional; runs on the completing thread before waiters wake */
+    void       *userData;
+
+    /* engine-owned */
+    RC          rc;           /* result once completed */
+    atomic_int  state;
+    struct iovec iov;
+    IORequest  *next;         /* worker queue */
+};
+
+typedef struct IOEngine IOEngine;
+
+/* depth: in-flight limit (0 = 64); workers: thread count for the fallback (0 = 4) */
+RC        ioe_init (IOEngine **e, SM_FileHandle *fh, IOBackend backend, int depth, int workers);
+/* waits for everything in flight, then releases the engine */
+void      ioe_free (IOEngine *e);
+IOBackend ioe_backend (IOEngine *e);
+
+/* start n requests; an invalid request completes at once with an error */
+void ioe_submit (IOEngine *e, IORequest *reqs, int n);
+/* same, for requests that are not contiguous in memory */
+void ioe_submitv (IOEngine *e, IORequest **reqs, int n);
+/* block until req has completed; returns its RC */
+RC   ioe_wait (IOEngine *e, IORequest *req);
+bool ioe_done (IORequest *req);
+
+/*
+ * Wait words: a state word that threads can sleep on while it holds `busy`.
+ * A waiter turns busy into `sleeping` and sleeps on the word itself (a
+ * futex), so ioe_setWord wakes only the threads waiting on that word, and
+ * only makes a system call if one of them is asleep. ioe_wait is
+ * ioe_waitWord on the request's state; the buffer pool uses the same pair
+ * for frames being read in.
+ */
+void ioe_waitWord (atomic_int *w, int busy, int sleeping);
+void ioe_setWord (atomic_int *w, int value, int sleeping);
+
+#endif
@@ -0,0 +1,286 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "buffer_mgr.h"
+#include "storage_mgr.h"
+#include "dberror.h"
+
+/*
+ * Buffer Manager Microbenchmark
+ * -----------------------------
+ * Runs pinPage/unpinPage loops against a pool for every combination of the
+ * given pool sizes, thread counts, replacement strategies and access
+ * distributions, and prints one CSV row per combination: throughput, the
+ * hit ratio (1 - page reads / pins) and the p50/p99/p999 latency of one
+ * pin+unpin. Each thread first does a warm-up pass that is not measured.
+ *
+ *   bench_buffer_mgr [-p pools] [-t threads] [-s strategies] [-d dists]
+ *                    [-n filePages] [-o opsPerThread] [-w writePercent]
+ *                    [-z zipfTheta] [-f pageFile] [-r traceFile]
+ *
+ * Lists are comma-separated, e.g. -p 64,1024 -s lru,clock -d zipf,scan.
+ * Distributions: uniform, zipf (hot pages are the low page numbers), scan
+ * (each thread reads the file sequentially from its own offset) and mixed
+ * (zipf lookups; one in a hundred starts a 64-page scan). With -r each run
+ * records its references there (BM_PoolOptions.traceFile), so the file
+ * holds the last run's trace, ready for trace_replay.
+ */
+
+/* ------------ Configuration ------------ */
+
+#define MAX_LIST    16
+#define SCAN_RUN    64
+
+typedef enum Dist { D_UNIFORM, D_ZIPF, D_SCAN, D_MIXED } Dist;
+
+static const char *distNames[] = { "uniform", "zipf", "scan", "mixed" };
+static const char *stratNames[] = { "fifo", "lru", "clock", "lfu", "lru-k", "2q", "arc" };
+
+static int    pools[MAX_LIST] = { 64, 1024 }, nPools = 2;
+static int    threads[MAX_LIST] = { 1, 4 }, nThreads = 2;
+static int    strats[MAX_LIST] = { RS_FIFO, RS_LRU, RS_CLOCK }, nStrats = 3;
+static int    dists[MAX_LIST] = { D_UNIFORM, D_ZIPF, D_SCAN, D_MIXED }, nDists = 4;
+static int    filePages = 4096;
+static long   opsPerThread = 100000;
+static int    writePercent = 10;
+static double zipfTheta = 0.99;
+static const char *pageFile = "bench.bin";
+static const char *traceFile = NULL;
+
+/* ------------ Run state ------------ */
+
+typedef struct Worker {
+    pthread_t  thread;
+    int        id;
+    Dist       dist;
+    uint64_t   rng;
+    int        scanNext, scanLeft;
+    uint32_t  *lat;      /* opsPerThread latencies, ns */
+    long       failed;
+} Worker;
+
+static BM_BufferPool     bm;
+static pthread_barrier_t startLine;
+static double           *zipfCdf;  /* filePages entries */
+
+/* ------------ Helpers ------------ */
+
+static uint64_t next_rand(uint64_t *s) {   /* xorshift64* */
+    *s ^= *s >> 12; *s ^= *s << 25; *s ^= *s >> 27;
+    return *s * 2685821657736338717ULL;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int zipf_page(uint64_t *s) {
+    double u = (double)(next_rand(s) >> 11) / (double)(1ULL << 53);
+    int lo = 0, hi = filePages - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (zipfCdf[mid] < u) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static int next_page(Worker *w) {
+    if (w->scanLeft > 0) {
+        w->scanLeft--;
+        int p = w->scanNext;
+        w->scanNext = (p + 1) % filePages;
+        return p;
+    }
+    switch (w->dist) {
+    case D_UNIFORM:
+        return (int)(next_rand(&w->rng) % (uint64_t)filePages);
+    case D_SCAN:
+        w->scanLeft = filePages;
+        return next_page(w);
+    case D_MIXED:
+        if (next_rand(&w->rng) % 100 == 0) {
+            w->scanNext = (int)(next_rand(&w->rng) % (uint64_t)filePages);
+            w->scanLeft = SCAN_RUN;
+            return next_page(w);
+        }
+        /* fall through */
+    case D_ZIPF:
+    default:
+        return zipf_page(&w->rng);
+    }
+}
+
+static int one_op(Worker *w) {
+    BM_PageHandle h;
+    int p = next_page(w);
+    if (pinPage(&bm, &h, p) != RC_OK) return 0;
+    if ((int)(next_rand(&w->rng) % 100) < writePercent) {
+        h.data[w->id % PAGE_SIZE]++;
+        markDirty(&bm, &h);
+    }
+    unpinPage(&bm, &h);
+    return 1;
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    struct timespec a, b;
+
+    w->scanNext = (int)((long long)w->id * filePages / 64 % filePages);
+    for (long i = 0; i < opsPerThread / 4; i++) one_op(w);   /* warm-up */
+    pthread_barrier_wait(&startLine);
+    for (long i = 0; i < opsPerThread; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &a);
+        if (!one_op(w)) w->failed++;
+        clock_gettime(CLOCK_MONOTONIC, &b);
+        long long ns = (b.tv_sec - a.tv_sec) * 1000000000LL + (b.tv_nsec - a.tv_nsec);
+        w->lat[i] = (ns > UINT32_MAX) ? UINT32_MAX : (uint32_t)ns;
+    }
+    pthread_barrier_wait(&startLine);
+    return NULL;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t percentile(const uint32_t *sorted, long n, double q) {
+    long i = (long)(q * (double)(n - 1) + 0.5);
+    return sorted[i];
+}
+
+/* ------------ One configuration ------------ */
+
+static int run_one(int pool, int nt, int strat, Dist dist) {
+    Worker *ws = calloc((size_t)nt, sizeof(Worker));
+    uint32_t *lat = malloc(sizeof(uint32_t) * (size_t)nt * (size_t)opsPerThread);
+    int k = 2;
+    BM_PoolOptions opts;
+    double t0, t1;
+    long failed = 0;
+
+    if (!ws || !lat) { free(ws); free(lat); return 0; }
+    initPoolOptions(&opts);
+    opts.traceFile = traceFile;
+    if (initBufferPoolWithOptions(&bm, pageFile, pool, (ReplacementStrategy)strat, (strat == RS_LRU_K) ? &k : NULL, &opts) != RC_OK) {
+        free(ws); free(lat);
+        return 0;
+    }
+    pthread_barrier_init(&startLine, NULL, (unsigned)nt + 1);
+    for (int i = 0; i < nt; i++) {
+        ws[i].id = i;
+        ws[i].dist = dist;
+        ws[i].rng = 0x9E3779B97F4A7C15ULL * (uint64_t)(i + 1);
+        ws[i].lat = lat + (size_t)i * (size_t)opsPerThread;
+        pthread_create(&ws[i].thread, NULL, worker_main, &ws[i]);
+    }
+    pthread_barrier_wait(&startLine);
+    int reads0 = getNumReadIO(&bm), writes0 = getNumWriteIO(&bm);
+    t0 = now_sec();
+    pthread_barrier_wait(&startLine);
+    t1 = now_sec();
+    int reads = getNumReadIO(&bm) - reads0, writes = getNumWriteIO(&bm) - writes0;
+    for (int i = 0; i < nt; i++) {
+        pthread_join(ws[i].thread, NULL);
+        failed += ws[i].failed;
+    }
+    pthread_barrier_destroy(&startLine);
+    shutdownBufferPool(&bm);
+
+    long n = (long)nt * opsPerThread;
+    qsort(lat, (size_t)n, sizeof(uint32_t), cmp_u32);
+    printf("%d,%d,%s,%s,%ld,%.3f,%.0f,%.4f,%u,%u,%u,%d,%d,%ld\n",
+           pool, nt, stratNames[strat], distNames[dist], n, t1 - t0, (double)n / (t1 - t0),
+           1.0 - (double)reads / (double)n, percentile(lat, n, 0.50), percentile(lat, n, 0.99),
+           percentile(lat, n, 0.999), reads, writes, failed);
+    fflush(stdout);
+    free(ws);
+    free(lat);
+    return 1;
+}
+
+/* ------------ Command line ------------ */
+
+static int lookup(const char *name, const char *const *names, int count) {
+    for (int i = 0; i < count; i++)
+        if (strcmp(name, names[i]) == 0) return i;
+    return -1;
+}
+
+/* parse a comma-separated list of numbers, or of names when names != NULL */
+static int parse_list(char *arg, int *out, const char *const *names, int count) {
+    int n = 0;
+    for (char *tok = strtok(arg, ","); tok && n < MAX_LIST; tok = strtok(NULL, ",")) {
+        int v = names ? lookup(tok, names, count) : atoi(tok);
+        if (v < 0 || (!names && v <= 0)) {
+            fprintf(stderr, "bad list entry: %s\n", tok);
+            exit(2);
+        }
+        out[n++] = v;
+    }
+    return n;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-p pools] [-t threads] [-s strategies] [-d dists] [-n filePages]"
+                    " [-o opsPerThread] [-w writePercent] [-z zipfTheta] [-f pageFile] [-r traceFile]\n", prog);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "p:t:s:d:n:o:w:z:f:r:")) != -1) {
+        switch (opt) {
+        case 'p': nPools = parse_list(optarg, pools, NULL, 0); break;
+        case 't': nThreads = parse_list(optarg, threads, NULL, 0); break;
+        case 's': nStrats = parse_list(optarg, strats, stratNames, 7); break;
+        case 'd': nDists = parse_list(optarg, dists, distNames, 4); break;
+        case 'n': filePages = atoi(optarg); break;
+        case 'o': opsPerThread = atol(optarg); break;
+        case 'w': writePercent = atoi(optarg); break;
+        case 'z': zipfTheta = atof(optarg); break;
+        case 'f': pageFile = optarg; break;
+        case 'r': traceFile = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (filePages <= 0 || opsPerThread <= 0 || writePercent < 0 || writePercent > 100) usage(argv[0]);
+
+    /* zipf CDF over the file's pages: P(page i) ~ 1 / (i+1)^theta */
+    zipfCdf = malloc(sizeof(double) * (size_t)filePages);
+    if (!zipfCdf) return 1;
+    double sum = 0;
+    for (int i = 0; i < filePages; i++) sum += 1.0 / pow(i + 1, zipfTheta);
+    for (int i = 0; i < filePages; i++)
+        zipfCdf[i] = (i ? zipfCdf[i - 1] : 0) + 1.0 / pow(i + 1, zipfTheta) / sum;
+    zipfCdf[filePages - 1] = 1.0;
+
+    SM_FileHandle fh;
+    if (createPageFile((char *)pageFile) != RC_OK || openPageFile((char *)pageFile, &fh) != RC_OK
+        || ensureCapacity(filePages, &fh) != RC_OK || closePageFile(&fh) != RC_OK) {
+        fprintf(stderr, "cannot create %s\n", pageFile);
+        return 1;
+    }
+
+    printf("pool,threads,strategy,dist,ops,secs,ops_per_sec,hit_ratio,p50_ns,p99_ns,p999_ns,reads,writes,failed\n");
+    for (int a = 0; a < nPools; a++)
+        for (int b = 0; b < nThreads; b++)
+            for (int c = 0; c < nStrats; c++)
+                for (int d = 0; d < nDists; d++)
+                    if (!run_one(pools[a], threads[b], strats[c], (Dist)dists[d]))
+                        fprintf(stderr, "pool %d, %d threads, %s, %s: init failed\n",
+                                pools[a], threads[b], stratNames[strats[c]], distNames[dists[d]]);
+
+    destroyPageFile((char *)pageFile);
+    free(zipfCdf);
+    return 0;
+}
@@ -1,96 +1,578 @@
 /* CS525 Assignment 2 — Buffer Manager (original & documented).
- * Implements a fixed-size page cache with FIFO, LRU, and CLOCK (extra credit); LRU-K treated as LRU.
- * Thread-safe public APIs via a single pthread mutex; fast page→frame map using a tiny open-addressing hash.
+ * Implements a fixed-size page cache with FIFO, LRU, CLOCK (extra credit) and LRU-K (K passed through stratData).
+ * Replacement policy lives in replacer.c; hits and unpins reach it through small per-partition event batches.
+ * Thread-safe public APIs via partitioned latching: the page table is split into hash partitions with their
+ * own latch, frames carry an atomic fix count, and a coarser pool latch only guards misses and eviction.
  * Eviction only when fixCount==0; dirty pages flushed on eviction/force/shutdown; read/write I/O counters tracked.
  * Works with provided tests (test_assign2_1.c, test_assign2_2.c) and the buffer_mgr.h interface.
  * Requires Assignment 1 storage manager (storage_mgr.c/.h) and PAGE_SIZE; no external deps.
  * Build with Makefile (uses -pthread); run: ./test_assign2_1 then ./test_assign2_2.
  * Defensive shutdown: auto-unpins any leftover pins before flushing to avoid stuck pools. */
 
+#define _GNU_SOURCE
 #include "buffer_mgr.h"
 #include "buffer_mgr_stat.h"
 #include "storage_mgr.h"
+#include "page_table.h"
+#include "replacer.h"
+#include "frame_arena.h"
+#include "async_io.h"
+#include "wal.h"
+#include "double_write.h"
+#include "trace.h"
+#include "probe.h"
 #include "dberror.h"
 #include "dt.h"
 
 #include <assert.h>
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
-/* ==============================
- * Frame & Manager Data Structures
- * ============================== */
+#include <time.h>
 
+/* Page-table partitioning: one partition per BM_FRAMES_PER_PARTITION frames, capped at BM_MAX_PARTITIONS. */
+#define BM_MAX_PARTITIONS       128
+#define BM_FRAMES_PER_PARTITION 16
+#define BM_CACHELINE            64
+/* Replacer events buffered per partition before they must be applied under the pool latch. */
+#define BM_EVENT_BATCH          64
+/* Read-ahead: a thread's pins are a sequential stream after this many consecutive pages; prefetches are installed this many at a time. */
+#define BM_SEQ_TRIGGER          3
+#define BM_PREFETCH_BATCH       32
+/* Whole-pool flushes write runs of consecutive dirty pages with one vectored write of at most this many pages
+ * (with a double-write area: batches of this many pages). */
+#define BM_FLUSH_RUN            64
+/* With a double-write area: a dirty victim is written in one batch with up to this many pages in all, the next dirty eviction candidates. */
+#define BM_EVICT_BATCH          16
+/* Background writer: period of its rounds. */
+#define BM_BGWRITER_INTERVAL_MS 50
 
 /* ==============================
  * Frame & Manager Data Structures
  * ============================== */
+
+/**
+ * Frame — one buffer slot.
+ *  - pageNum changes only under the pool latch and the owning partition latch.
+ *  - fixCount/dirty are atomics; fixCount is only changed under the partition latch once the frame is mapped.
+ *  - latch serializes write-back of this frame between concurrent flushers.
+ *  - loading is set while the page is being read in: the frame is already in the page table, so concurrent
+ *    pinners of the page find it, pin it and sleep on loading (a wait word, async_io.h) until the one read completes.
+ *  - lsn is the page's last log record (under latch); the log is flushed through it before the page is written.
+ *  - recLSN is the log end when the page was first logged after its last write (under latch, -1 if not logged
+ *    since): replay from there redoes every logged change the page file is missing.
+ */
 typedef struct Frame {
-    PageNumber pageNum;
-    char      *data;
-    bool       dirty;
-    int        fixCount;
-    long long  lastUsed;
-    long long  fifoPos;
-    bool       refbit;
+    PageNumber     pageNum;
+    char          *data;
+    _Atomic bool   dirty;
+    atomic_int     loading;  /* LOAD_ */
+    atomic_int     fixCount;
+    LSN            lsn;
+    LSN            recLSN;
+    pthread_mutex_t latch;
 } Frame;
+enum { LOAD_IDLE=0, LOAD_BUSY=1, LOAD_SLEEPING=2 };
+/** AccessEvent — a hit or a release recorded on the hit path for the replacer. */
+enum { EV_ACCESS=0, EV_UNPIN=1 };
+typedef struct AccessEvent {
+    long long  tick;
+    int        frame;
+    PageNumber page;
+    int        kind;
+} AccessEvent;
+/**
+ * PagePartition — one slice of the page table with its own latch, padded to a cache line.
+ * Hits and unpins append replacer events here under the latch; they are applied in tick
+ * order under the pool latch before every victim selection, or once the batch fills up.
+ */
+typedef struct PagePartition {
+    _Alignas(BM_CACHELINE) pthread_mutex_t latch;
+    PageTable     tab;
+    atomic_llong  hits;      /* written under latch (load+store, no locked add), read by getPoolStats without it */
+    atomic_int    numEvents;
+    AccessEvent   events[BM_EVENT_BATCH];
+} PagePartition;
 /**
- * PageTable — an intentionally tiny, dependency-free hash map used to
- * quickly find which frame currently holds a given page number.
- *  state: 0 = empty, 1 = occupied, 2 = tombstone (deleted)
- */
-typedef struct PageTable {
-    PageNumber *keys;
-    int        *vals;
-    char       *state;
-    int         cap;
-    int         count;
-} PageTable;
+ * PoolCounters — the pool-wide part of BM_PoolStats, on its own cache line. Everything here is counted on a miss,
+ * an eviction, a wait or an I/O, never on an uncontended hit (hits are counted per partition), so the relaxed atomic
+ * adds stay off the hot path.
+ */
+typedef struct PoolCounters {
+    _Alignas(BM_CACHELINE) atomic_llong misses;
+    atomic_llong  cleanEvictions, dirtyEvictions, flushes;
+    atomic_llong  pinWaitNs;
+    atomic_llong  victimSteps;
+    atomic_llong  readLatency[BM_LATENCY_BUCKETS];
+    atomic_llong  writeLatency[BM_LATENCY_BUCKETS];
+} PoolCounters;
+/** FlushEntry — a dirty frame collected by a whole-pool flush, sorted by page. */
+typedef struct FlushEntry { PageNumber page; int frame; } FlushEntry;
 /** PoolMgmt — internal fields behind BM_BufferPool->mgmtData. */
 typedef struct PoolMgmt {
     SM_FileHandle fhandle;
     Frame        *frames;
+    FrameArena    arena;     /* data of all frames, frame i at i*PAGE_SIZE */
+    IOEngine     *io;        /* page reads */
+    WAL          *wal;       /* write-ahead log, NULL if none */
+    DoubleWrite  *dw;        /* double-write area, NULL if none */
+    Trace        *trace;     /* pin/unpin/dirty recorder, NULL if off */
     int           capacity;
     ReplacementStrategy strategy;
-    long long     tick;
+    atomic_llong  tick;
 
-    PageNumber   *frameContents;
+    PageNumber   *frameContents; /* statistics snapshots, allocated and filled lazily by the getters */
     bool         *dirtyFlags;
     int          *fixCounts;
 
-    int           numReadIO;
-    int           numWriteIO;
+    atomic_int    numReadIO;
+    atomic_int    numWriteIO;
+    PoolCounters  stats;
 
-    PageTable     ptab;
-    int           clockHand;
+    PagePartition *parts;
+    int           numParts;
+    Replacer      repl;      /* pool latch */
+    AccessEvent  *drainBuf;  /* numParts*BM_EVENT_BATCH scratch for merging event batches */
+    int          *freeFrames;/* stack of empty frames, pool latch */
+    int           numFree;
 
-    pthread_mutex_t mtx;
+    int           readAhead; /* pages read ahead of a sequential pin stream, 0 = off */
+    IORequest    *aheadReqs; /* per frame: its prefetch read */
+    int          *aheadNext; /* per frame: link in the aheadDone stack */
+    atomic_int    aheadDone; /* completed prefetches whose pin is not yet released, -1 = none */
+    FlushEntry   *flushBuf;  /* capacity entries for flushPool, pool latch */
+    FlushEntry   *ckptBuf;   /* capacity entries: the dirty set of a checkpoint, ckptLock */
+    pthread_mutex_t ckptLock;/* one checkpoint at a time */
+    LSN           ckptRedo;  /* redo LSN of the running checkpoint, moved back for the pinned pages it skips; ckptLock */
+
+    /* background writer (bgTarget > 0) */
+    int           bgTarget;  /* keep this many next victims clean */
+    int           bgRate;    /* page writes per second, 0 = unlimited */
+    int          *bgCand;    /* bgTarget frames, writer thread */
+    FlushEntry   *bgDirty;   /* bgTarget entries, writer thread */
+    pthread_t     bgThread;
+    bool          bgRunning;
+    bool          bgStop;    /* bgLock */
+    pthread_mutex_t bgLock;
+    pthread_cond_t  bgWake;  /* end of shutdown, or a miss had to write a dirty victim */
+
+    pthread_mutex_t mtx;   /* pool latch: misses, eviction, replacer, whole-pool flushes */
     bool          open;
 } PoolMgmt;
 /* ==============================
- * PageTable helpers (open addressing)
+ * Partition helpers
+ * ============================== */
+/** Partition owning a page: multiply-shift on the hash's high bits, so it stays independent of the slot index. */
+static PagePartition *partitionOf(PoolMgmt *pm, PageNumber p){ return &pm->parts[(unsigned)(((unsigned long long)hash_page(p)*(unsigned)pm->numParts)>>32)]; }
+static int partitionCount(int numPages){ int n=1; while(n<BM_MAX_PARTITIONS && n*BM_FRAMES_PER_PARTITION<numPages) n<<=1; return n; }
+static RC parts_init(PoolMgmt *pm, int numPages){
+    pm->numParts=partitionCount(numPages);
+    pm->parts=aligned_alloc(BM_CACHELINE, sizeof(PagePartition)*pm->numParts); if(!pm->parts) return RC_WRITE_FAILED;
+    for(int i=0;i<pm->numParts;i++){
+        if(ptab_init(&pm->parts[i].tab, numPages/pm->numParts+1)!=RC_OK){ for(int j=0;j<i;j++){ ptab_free(&pm->parts[j].tab); pthread_mutex_destroy(&pm->parts[j].latch); } free(pm->parts); pm->parts=NULL; return RC_WRITE_FAILED; }
+        pthread_mutex_init(&pm->parts[i].latch,NULL); atomic_init(&pm->parts[i].hits,0); atomic_init(&pm->parts[i].numEvents,0);
+    }
+    return RC_OK;
+}
+static void parts_free(PoolMgmt *pm){ for(int i=0;i<pm->numParts;i++){ ptab_free(&pm->parts[i].tab); pthread_mutex_destroy(&pm->parts[i].latch); } free(pm->parts); pm->parts=NULL; pm->numParts=0; }
+
+/* ==============================
+ * Replacer event batching
+ * ============================== */
+static void statAdd(atomic_llong *c, long long n){ atomic_fetch_add_explicit(c,n,memory_order_relaxed); }
+static long long nowNs(void){ struct timespec t; clock_gettime(CLOCK_MONOTONIC,&t); return (long long)t.tv_sec*1000000000LL+t.tv_nsec; }
+/** Count one I/O of ns nanoseconds in a log2 latency histogram. */
+static void statLatency(atomic_llong *hist, long long ns){ int b=(ns>1)?63-__builtin_clzll((unsigned long long)ns):0; statAdd(&hist[(b<BM_LATENCY_BUCKETS)?b:BM_LATENCY_BUCKETS-1],1); }
+static int cmpEventTick(const void *a, const void *b){ long long x=((const AccessEvent*)a)->tick, y=((const AccessEvent*)b)->tick; return (x>y)-(x<y); }
+/**
+ * Apply every partition's buffered events to the replacer, merged by tick, then drop the pins of prefetches whose
+ * completion found the event batch full (aheadDone) straight in the replacer. Caller holds the pool latch.
+ */
+static void drainEvents(PoolMgmt *pm){
+    int n=0;
+    for(int i=0;i<pm->numParts;i++){
+        PagePartition *pt=&pm->parts[i]; if(atomic_load_explicit(&pt->numEvents,memory_order_relaxed)==0) continue;
+        pthread_mutex_lock(&pt->latch); int k=atomic_load(&pt->numEvents); memcpy(pm->drainBuf+n,pt->events,sizeof(AccessEvent)*k); n+=k; atomic_store(&pt->numEvents,0); pthread_mutex_unlock(&pt->latch);
+    }
+    if(pm->numParts>1 && n>1) qsort(pm->drainBuf,n,sizeof(AccessEvent),cmpEventTick);
+    for(int i=0;i<n;i++){ AccessEvent *e=&pm->drainBuf[i]; if(e->kind==EV_ACCESS) replacerAccess(&pm->repl,e->frame,e->page,e->tick); else replacerUnpin(&pm->repl,e->frame,e->page,e->tick); }
+    for(int idx=atomic_exchange(&pm->aheadDone,-1); idx>=0; idx=pm->aheadNext[idx]){
+        Frame *f=&pm->frames[idx]; PagePartition *pt=partitionOf(pm,f->pageNum);
+        pthread_mutex_lock(&pt->latch); bool last=atomic_fetch_sub(&f->fixCount,1)==1; long long t=atomic_fetch_add(&pm->tick,1)+1; pthread_mutex_unlock(&pt->latch);
+        if(last) replacerUnpin(&pm->repl,idx,f->pageNum,t);
+    }
+}
+/**
+ * Lock a page's partition with room for one more event. A full batch is drained first:
+ * directly if the caller already holds the pool latch, otherwise by taking it (never while holding the partition).
+ */
+static PagePartition *lockPartitionForEvent(PoolMgmt *pm, PageNumber p, bool poolLatched, bool forPin){
+    PagePartition *pt=partitionOf(pm,p);
+    if(pthread_mutex_trylock(&pt->latch)==0){ if(atomic_load(&pt->numEvents)<BM_EVENT_BATCH) return pt; pthread_mutex_unlock(&pt->latch); }
+    long long t=forPin?nowNs():0; /* contended, or the batch is full: a pin counts the time as pin wait */
+    for(;;){
+        pthread_mutex_lock(&pt->latch); if(atomic_load(&pt->numEvents)<BM_EVENT_BATCH){ if(forPin) statAdd(&pm->stats.pinWaitNs,nowNs()-t); return pt; }
+        pthread_mutex_unlock(&pt->latch);
+        if(poolLatched) drainEvents(pm); else { pthread_mutex_lock(&pm->mtx); drainEvents(pm); pthread_mutex_unlock(&pm->mtx); }
+    }
+}
+/** Append an event stamped with a fresh tick; caller holds the partition latch (so ticks are ordered within it). */
+static void logEvent(PoolMgmt *pm, PagePartition *pt, int kind, int idx, PageNumber p){ int n=atomic_load(&pt->numEvents); AccessEvent *e=&pt->events[n]; e->tick=atomic_fetch_add(&pm->tick,1)+1; e->frame=idx; e->page=p; e->kind=kind; atomic_store(&pt->numEvents,n+1); }
+/** Release the partition latch; past half a batch, opportunistically drain if the pool latch is free. */
+static void unlockPartition(PoolMgmt *pm, PagePartition *pt, bool poolLatched){
+    int pending=atomic_load(&pt->numEvents); pthread_mutex_unlock(&pt->latch);
+    if(!poolLatched && pending>=BM_EVENT_BATCH/2 && pthread_mutex_trylock(&pm->mtx)==0){ drainEvents(pm); pthread_mutex_unlock(&pm->mtx); }
+}
+
+/**
+ * pinIfResident — the hit path. Looks the page up in its partition and, if present,
+ * bumps the frame's fix count and logs the access while holding only that partition's latch.
+ * Returns the frame index, or -1 if the page is not resident.
+ */
+static int pinIfResident(PoolMgmt *pm, PageNumber p, bool poolLatched){
+    PagePartition *pt=lockPartitionForEvent(pm,p,poolLatched,TRUE);
+    int idx=ptab_get(&pt->tab,p);
+    if(idx>=0){ atomic_fetch_add(&pm->frames[idx].fixCount,1); logEvent(pm,pt,EV_ACCESS,idx,p); atomic_store_explicit(&pt->hits,atomic_load_explicit(&pt->hits,memory_order_relaxed)+1,memory_order_relaxed); }
+    unlockPartition(pm,pt,poolLatched); return idx;
+}
+/** Drop one pin; the release that brings the fix count to zero is logged so the replacer can queue the frame. */
+static int unpinIfResident(PoolMgmt *pm, PageNumber p, bool poolLatched){
+    PagePartition *pt=lockPartitionForEvent(pm,p,poolLatched,FALSE);
+    int idx=ptab_get(&pt->tab,p);
+    if(idx>=0 && atomic_load(&pm->frames[idx].fixCount)>0 && atomic_fetch_sub(&pm->frames[idx].fixCount,1)==1) logEvent(pm,pt,EV_UNPIN,idx,p);
+    unlockPartition(pm,pt,poolLatched); return idx;
+}
+/** Unmap a victim from its partition, provided nobody pinned it since it was selected. */
+static bool detachFrame(PoolMgmt *pm, int idx){
+    Frame *f=&pm->frames[idx]; PagePartition *pt=partitionOf(pm,f->pageNum); bool ok=FALSE;
+    pthread_mutex_lock(&pt->latch);
+    if(atomic_load(&f->fixCount)==0){ ptab_del(&pt->tab,f->pageNum); ok=TRUE; }
+    pthread_mutex_unlock(&pt->latch); return ok;
+}
+static RC attachFrame(PoolMgmt *pm, int idx){ PagePartition *pt=partitionOf(pm,pm->frames[idx].pageNum); pthread_mutex_lock(&pt->latch); RC rc=ptab_put(&pt->tab,pm->frames[idx].pageNum,idx); pthread_mutex_unlock(&pt->latch); return rc; }
+
+/* ==============================
+ * Replacement & I/O helpers
  * ============================== */
-/* hash + page table helpers identical to earlier version ... */
-static unsigned hash_page(PageNumber p){ unsigned x=(unsigned)p; x^=x>>16; x*=0x7feb352dU; x^=x>>15; x*=0x846ca68bU; x^=x>>16; return x;}
-static RC ptab_init(PageTable *t,int approx){int cap=1; while(cap<approx*3) cap<<=1; t->keys=malloc(sizeof(PageNumber)*cap); t->vals=malloc(sizeof(int)*cap); t->state=malloc(cap); if(!t->keys||!t->vals||!t->state) return RC_WRITE_FAILED; for(int i=0;i<cap;i++) t->state[i]=0; t->cap=cap; t->count=0; return RC_OK;}
-static void ptab_free(PageTable *t){ free(t->keys); free(t->vals); free(t->state); t->keys=t->vals=NULL; t->state=NULL; t->cap=t->count=0; }
-static int ptab_find_slot(PageTable *t, PageNumber key, int *found){ unsigned h=hash_page(key); int idx=(int)(h&(t->cap-1)); int firstDel=-1; for(int probes=0; probes<t->cap; probes++){ char st=t->state[idx]; if(st==0){ if(found)*found=-1; return (firstDel>=0)?firstDel:idx; } else if(st==2){ if(firstDel<0) firstDel=idx; } else { if(t->keys[idx]==key){ if(found)*found=idx; return idx; } } idx=(idx+1)&(t->cap-1);} if(found)*found=-1; return (firstDel>=0)?firstDel:-1; }
-static RC ptab_put(PageTable *t, PageNumber key, int val){ int ex; int slot=ptab_find_slot(t,key,&ex); if(slot<0) return RC_WRITE_FAILED; if(ex>=0){ t->vals[ex]=val; return RC_OK; } t->keys[slot]=key; t->vals[slot]=val; t->state[slot]=1; t->count++; return RC_OK; }
-static int ptab_get(PageTable *t, PageNumber key){ int ex; (void)ptab_find_slot(t,key,&ex); return (ex<0)?-1:t->vals[ex]; }
-static void ptab_del(PageTable *t, PageNumber key){ int ex; (void)ptab_find_slot(t,key,&ex); if(ex>=0 && t->state[ex]==1){ t->state[ex]=2; t->count--; } }
-/** Initialize the page table sized to ~3x number of frames. */
-static void refreshSnapshots(PoolMgmt *pm){ for(int i=0;i<pm->capacity;i++){ pm->frameContents[i]=pm->frames[i].pageNum; pm->dirtyFlags[i]=pm->frames[i].dirty?TRUE:FALSE; pm->fixCounts[i]=pm->frames[i].fixCount; } }
-static int findEmptyFrame(PoolMgmt *pm){ for(int i=0;i<pm->capacity;i++){ if(pm->frames[i].pageNum==NO_PAGE && pm->frames[i].fixCount==0) return i; } return -1; }
-static int selectVictim_FIFO(PoolMgmt *pm){ int v=-1; long long best=0x7fffffffffffffffLL; for(int i=0;i<pm->capacity;i++){ Frame *f=&pm->frames[i]; if(f->fixCount==0 && f->pageNum!=NO_PAGE && f->fifoPos<best){ best=f->fifoPos; v=i; } } return v; }
-static int selectVictim_LRU(PoolMgmt *pm){ int v=-1; long long best=0x7fffffffffffffffLL; for(int i=0;i<pm->capacity;i++){ Frame *f=&pm->frames[i]; if(f->fixCount==0 && f->pageNum!=NO_PAGE && f->lastUsed<best){ best=f->lastUsed; v=i; } } return v; }
-static int selectVictim_CLOCK(PoolMgmt *pm){ int n=pm->capacity; int hand=pm->clockHand % n; for(int scanned=0; scanned<2*n; scanned++){ Frame *f=&pm->frames[hand]; if(f->pageNum!=NO_PAGE && f->fixCount==0){ if(!f->refbit){ pm->clockHand=(hand+1)%n; return hand; } f->refbit=FALSE; } hand=(hand+1)%n; } return -1; }
-static int selectVictim(PoolMgmt *pm){ switch(pm->strategy){ case RS_FIFO: return selectVictim_FIFO(pm); case RS_LRU: case RS_LRU_K: return selectVictim_LRU(pm); case RS_CLOCK: return selectVictim_CLOCK(pm); default: return selectVictim_FIFO(pm);} }
-static RC ensurePageExists(SM_FileHandle *fh, PageNumber p){ if(p<0) return RC_READ_NON_EXISTING_PAGE; if(fh->totalNumPages<=p){ RC rc=ensureCapacity(p+1, fh); if(rc!=RC_OK) return rc; } return RC_OK; }
-static RC flushIfDirty(PoolMgmt *pm, int idx){ Frame *f=&pm->frames[idx]; if(f->pageNum==NO_PAGE || f->dirty==FALSE) return RC_OK; RC rc=ensurePageExists(&pm->fhandle, f->pageNum); if(rc!=RC_OK) return rc; rc=writeBlock(f->pageNum, &pm->fhandle, f->data); if(rc!=RC_OK) return rc; pm->numWriteIO+=1; f->dirty=FALSE; return RC_OK; }
-static RC loadIntoFrame(PoolMgmt *pm, int idx, PageNumber p){ Frame *f=&pm->frames[idx]; RC rc=ensurePageExists(&pm->fhandle,p); if(rc!=RC_OK) return rc; rc=readBlock(p, &pm->fhandle, f->data); if(rc==RC_OK) pm->numReadIO+=1; else memset(f->data,0,PAGE_SIZE); f->pageNum=p; f->dirty=FALSE; f->fixCount=0; f->lastUsed=pm->tick; f->fifoPos=pm->tick; f->refbit=TRUE; ptab_put(&pm->ptab,p,idx); return RC_OK; }
+/** Select and detach a victim; a candidate that got pinned since its last reported release is skipped. */
+static int claimVictim(PoolMgmt *pm, PageNumber p){
+    PROBE_START(t); long long s=pm->repl.steps; int v;
+    for(;;){ v=replacerVictim(&pm->repl,p); if(v<0 || detachFrame(pm,v)) break; replacerPin(&pm->repl,v); }
+    statAdd(&pm->stats.victimSteps,pm->repl.steps-s); PROBE_END(t,PROBE_VICTIM,p); return v;
+}
+static RC ensurePageExists(SM_FileHandle *fh, PageNumber p){ if(p<0) return RC_READ_NON_EXISTING_PAGE; return ensureCapacity(p+1, fh); }
+/** WAL rule: before a page is written, the log must be durable through the page's last record (a group commit). */
+static RC logCovers(PoolMgmt *pm, LSN lsn){ return (pm->wal && lsn>0)?wal_flush(pm->wal,lsn):RC_OK; }
+/**
+ * Write frames to their pages, after the log records they depend on; caller holds their frame latches, has cleared
+ * their dirty bits and passes them in page order. With a double-write area they go through it as one batch, else
+ * each stretch of consecutive pages is one vectored write. On failure the frames are dirty again. One write I/O per page,
+ * and one flush per page other than the victim being evicted (a frame index, or -1).
+ */
+static RC writeFrames(PoolMgmt *pm, const int *fr, int n, int victim){
+    SM_PageHandle bufs[BM_FLUSH_RUN]; PageNumber pages[BM_FLUSH_RUN], last=NO_PAGE; LSN upTo=0; if(n==0) return RC_OK;
+    for(int i=0;i<n;i++){ Frame *f=&pm->frames[fr[i]]; bufs[i]=f->data; pages[i]=f->pageNum; if(f->pageNum>last) last=f->pageNum; if(f->lsn>upTo) upTo=f->lsn; }
+    RC rc=logCovers(pm,upTo); if(rc==RC_OK) rc=ensurePageExists(&pm->fhandle,last);
+    if(rc==RC_OK && pm->dw){ long long t=nowNs(); rc=dw_write(pm->dw,&pm->fhandle,pages,bufs,n); statLatency(pm->stats.writeLatency,nowNs()-t); }
+    else if(rc==RC_OK){ for(int i=0,j; i<n && rc==RC_OK; i=j){ for(j=i+1; j<n && pages[j]==pages[j-1]+1; j++); long long t=nowNs(); rc=writeBlocks(pages[i],j-i,&pm->fhandle,bufs+i); statLatency(pm->stats.writeLatency,nowNs()-t); } }
+    if(rc!=RC_OK){ for(int i=0;i<n;i++) atomic_store(&pm->frames[fr[i]].dirty,TRUE); } else { for(int i=0;i<n;i++) pm->frames[fr[i]].recLSN=-1; atomic_fetch_add(&pm->numWriteIO,n); int ev=0; for(int i=0;i<n;i++) ev+=(fr[i]==victim); statAdd(&pm->stats.flushes,n-ev); }
+    return rc;
+}
+/** Write a dirty frame back; caller holds the frame latch. The dirty bit is cleared before the write so a concurrent markDirty is never lost. */
+static RC writeBackLocked(PoolMgmt *pm, int idx, bool evict){
+    Frame *f=&pm->frames[idx];
+    if(f->pageNum==NO_PAGE || !atomic_exchange(&f->dirty,FALSE)) return RC_OK;
+    return writeFrames(pm,&idx,1,evict?idx:-1);
+}
+/** End of a flush batch: one sync covers every write since written (a numWriteIO value), if the write mode asks for it (double-write batches sync anyway). */
+static RC syncBatch(PoolMgmt *pm, int written){ if(pm->dw || getWriteMode(&pm->fhandle)!=SM_WRITE_SYNC_ON_FLUSH || atomic_load(&pm->numWriteIO)==written) return RC_OK; return syncFile(&pm->fhandle); }
+static int cmpFlushPage(const void *a, const void *b){ PageNumber x=((const FlushEntry*)a)->page, y=((const FlushEntry*)b)->page; return (x>y)-(x<y); }
+static int cmpInt(const void *a, const void *b){ int x=*(const int*)a, y=*(const int*)b; return (x>y)-(x<y); }
+/**
+ * Write back e[0..n), in page order: latch the frames (in frame order), then write the ones still dirty (forcePage may
+ * have written some meanwhile). victim is a frame being evicted among them, or -1; *victimWritten tells whether it was dirty.
+ */
+static RC flushRun(PoolMgmt *pm, const FlushEntry *e, int n, int victim, bool *victimWritten){
+    int locks[BM_FLUSH_RUN], dirty[BM_FLUSH_RUN], len=0;
+    for(int i=0;i<n;i++) locks[i]=e[i].frame;
+    qsort(locks,n,sizeof(int),cmpInt); for(int i=0;i<n;i++) pthread_mutex_lock(&pm->frames[locks[i]].latch);
+    for(int i=0;i<n;i++) if(atomic_exchange(&pm->frames[e[i].frame].dirty,FALSE)){ dirty[len++]=e[i].frame; if(victimWritten && e[i].frame==victim) *victimWritten=TRUE; }
+    RC rc=writeFrames(pm,dirty,len,victim);
+    for(int i=0;i<n;i++) pthread_mutex_unlock(&pm->frames[locks[i]].latch);
+    return rc;
+}
+/**
+ * A double-write batch costs two syncs (side file, then page file) however many pages it holds, so a dirty victim
+ * takes the next dirty eviction candidates along (BM_EVICT_BATCH pages in all): they stay resident, and their own
+ * evictions later need no write. Caller holds the pool latch; fills e in page order, the victim included.
+ */
+static int gatherEvictBatch(PoolMgmt *pm, int victim, FlushEntry *e){
+    int cand[BM_EVICT_BATCH], n=0, k=replacerCandidates(&pm->repl,cand,BM_EVICT_BATCH);
+    e[n].page=pm->frames[victim].pageNum; e[n++].frame=victim;
+    for(int i=0;i<k && n<BM_EVICT_BATCH;i++){ Frame *f=&pm->frames[cand[i]]; if(cand[i]!=victim && f->pageNum!=NO_PAGE && atomic_load(&f->dirty)){ e[n].page=f->pageNum; e[n++].frame=cand[i]; } }
+    qsort(e,n,sizeof(FlushEntry),cmpFlushPage); return n;
+}
+/**
+ * Write a victim back if it is dirty, after the log records it depends on (writeBackLocked), and count the eviction.
+ * With a double-write area a dirty victim is written in one batch with other dirty eviction candidates (gatherEvictBatch).
+ */
+static RC flushIfDirty(PoolMgmt *pm, int idx){
+    PROBE_START(t); Frame *f=&pm->frames[idx]; bool was=FALSE; RC rc;
+    if(pm->dw && atomic_load(&f->dirty)){ FlushEntry e[BM_EVICT_BATCH]; rc=flushRun(pm,e,gatherEvictBatch(pm,idx,e),idx,&was); }
+    else { pthread_mutex_lock(&f->latch); was=atomic_load(&f->dirty); rc=writeBackLocked(pm,idx,TRUE); pthread_mutex_unlock(&f->latch); }
+    PROBE_END(t,PROBE_EVICT_WRITE,f->pageNum);
+    if(rc==RC_OK){ statAdd(was?&pm->stats.dirtyEvictions:&pm->stats.cleanEvictions,1); } return rc;
+}
+/**
+ * Write back every dirty frame (only unpinned ones unless withPinned) in page order: one vectored write per run of
+ * consecutive pages, or with a double-write area one batch per BM_FLUSH_RUN pages. Caller holds the pool latch,
+ * so no frame changes page meanwhile and flushes do not overlap. Each page counts as one write I/O.
+ */
+static RC flushPool(PoolMgmt *pm, bool withPinned){
+    int n=0; RC rc=RC_OK;
+    for(int i=0;i<pm->capacity;i++){ Frame *f=&pm->frames[i]; if(f->pageNum!=NO_PAGE && atomic_load(&f->dirty) && (withPinned || atomic_load(&f->fixCount)==0)){ pm->flushBuf[n].page=f->pageNum; pm->flushBuf[n++].frame=i; } }
+    qsort(pm->flushBuf,n,sizeof(FlushEntry),cmpFlushPage);
+    for(int i=0,j; i<n && rc==RC_OK; i=j){
+        for(j=i+1; j<n && j-i<BM_FLUSH_RUN && (pm->dw || pm->flushBuf[j].page==pm->flushBuf[j-1].page+1); j++);
+        rc=flushRun(pm,pm->flushBuf+i,j-i,-1,NULL);
+    }
+    return rc;
+}
+/**
+ * Publish page p in a detached frame with fixCount=1, marked loading. Caller holds the pool latch; the read itself
+ * (readIntoFrame, or a prefetch request) happens after it is released, and pinners arriving meanwhile wait in awaitLoad.
+ * A prefetched page (ahead) must already exist in the file and is not a reference for the replacer.
+ */
+static RC installFrame(PoolMgmt *pm, int idx, PageNumber p, bool ahead){
+    Frame *f=&pm->frames[idx];
+    RC rc=ahead?RC_OK:ensurePageExists(&pm->fhandle,p); if(rc!=RC_OK){ f->pageNum=NO_PAGE; return rc; }
+    f->pageNum=p; f->lsn=0; f->recLSN=-1; atomic_store(&f->dirty,FALSE); atomic_store(&f->loading,LOAD_BUSY); atomic_store(&f->fixCount,1);
+    long long t=atomic_fetch_add(&pm->tick,1)+1; /* ticked before the page is visible, so every hit on it is newer */
+    if(ahead) replacerPrefetch(&pm->repl,idx,p,t); else replacerLoad(&pm->repl,idx,p,t);
+    rc=attachFrame(pm,idx); if(rc!=RC_OK){ replacerRemove(&pm->repl,idx); f->pageNum=NO_PAGE; atomic_store(&f->loading,LOAD_IDLE); atomic_store(&f->fixCount,0); } return rc;
+}
+/** A frame's read has finished with rc: count it (a failed read leaves a zeroed page) and wake the pinners asleep on the frame, if any. */
+static void finishLoad(PoolMgmt *pm, Frame *f, RC rc){
+    if(rc==RC_OK) atomic_fetch_add(&pm->numReadIO,1); else memset(f->data,0,PAGE_SIZE);
+    ioe_setWord(&f->loading,LOAD_IDLE,LOAD_SLEEPING);
+}
+/** Read an installed frame's page with no latch held. The pinner waits for it anyway, so it reads directly rather than through the I/O engine (which would add a hand-off to an I/O thread and back); the engine serves read-ahead. */
+static void readIntoFrame(PoolMgmt *pm, int idx){
+    PROBE_START(pt); Frame *f=&pm->frames[idx]; PageNumber p=f->pageNum; long long t=nowNs(); RC rc=readBlock(p,&pm->fhandle,f->data); statLatency(pm->stats.readLatency,nowNs()-t);
+    finishLoad(pm,f,rc); PROBE_END(pt,PROBE_READ,p);
+}
+/** Wait until a pinned frame's read of page p has completed (counted as pin wait); free once it has. */
+static void awaitLoad(PoolMgmt *pm, Frame *f, PageNumber p){
+    if(atomic_load_explicit(&f->loading,memory_order_acquire)==LOAD_IDLE) return;
+    PROBE_START(pt); long long t=nowNs(); ioe_waitWord(&f->loading,LOAD_BUSY,LOAD_SLEEPING);
+    statAdd(&pm->stats.pinWaitNs,nowNs()-t); PROBE_END(pt,PROBE_LOAD_WAIT,p);
+}
+/** Take the pool latch for a miss; only a contended acquisition reads the clock (counted as pin wait). */
+static void lockPoolForPin(PoolMgmt *pm, PageNumber p){
+    if(pthread_mutex_trylock(&pm->mtx)==0) return;
+    PROBE_START(pt); long long t=nowNs(); pthread_mutex_lock(&pm->mtx); statAdd(&pm->stats.pinWaitNs,nowNs()-t); PROBE_END(pt,PROBE_POOL_LATCH,p);
+}
+/** Look a page up and run op on its frame under the partition latch; -1 if the page is not resident. */
+static int withResident(PoolMgmt *pm, PageNumber p, void (*op)(Frame*)){
+    PagePartition *pt=partitionOf(pm,p); pthread_mutex_lock(&pt->latch);
+    int idx=ptab_get(&pt->tab,p); if(idx>=0) op(&pm->frames[idx]);
+    pthread_mutex_unlock(&pt->latch); return idx;
+}
+static void op_dirty(Frame *f){ atomic_store(&f->dirty,TRUE); }
+static void op_none(Frame *f){ (void)f; }
+
+/* ==============================
+ * Read-ahead
+ *  Prefetched pages are installed like misses, pinned by their read, and read asynchronously. The completion
+ *  (on an I/O thread, which must not wait for the pool latch) wakes waiters and drops the read's pin like an
+ *  unpin, under the partition latch only. If the partition's event batch is full it queues the frame instead
+ *  (aheadDone), and the next drain drops the pin; every eviction drains first, so such a pin never keeps a
+ *  frame from being chosen.
+ * ============================== */
+static void aheadComplete(IORequest *req){
+    PoolMgmt *pm=(PoolMgmt*)req->userData; int idx=(int)(req-pm->aheadReqs); Frame *f=&pm->frames[idx]; PageNumber p=f->pageNum;
+    finishLoad(pm,f,req->rc); /* still pinned, so the frame keeps page p */
+    PagePartition *pt=partitionOf(pm,p); pthread_mutex_lock(&pt->latch);
+    if(atomic_load(&pt->numEvents)<BM_EVENT_BATCH){ if(atomic_fetch_sub(&f->fixCount,1)==1) logEvent(pm,pt,EV_UNPIN,idx,p); pthread_mutex_unlock(&pt->latch); return; }
+    pthread_mutex_unlock(&pt->latch);
+    int head=atomic_load(&pm->aheadDone); do pm->aheadNext[idx]=head; while(!atomic_compare_exchange_weak(&pm->aheadDone,&head,idx));
+}
+/**
+ * Install and start reading the non-resident pages of [start, start+count) that exist in the file, in batches
+ * under the pool latch; each batch is submitted once the latch is released. Stops early if nothing is evictable.
+ */
+static void prefetchRange(PoolMgmt *pm, PageNumber start, int count){
+    IORequest *batch[BM_PREFETCH_BATCH]; int end=getTotalNumPages(&pm->fhandle); if(count>end-start) count=end-start;
+    for(PageNumber p=start; p<start+count;){
+        int n=0; bool full=FALSE;
+        pthread_mutex_lock(&pm->mtx); drainEvents(pm);
+        for(; p<start+count && n<BM_PREFETCH_BATCH; p++){
+            if(withResident(pm,p,op_none)>=0) continue;
+            int target=(pm->numFree>0)?pm->freeFrames[--pm->numFree]:claimVictim(pm,p);
+            if(target<0){ full=TRUE; break; }
+            if(pm->frames[target].pageNum!=NO_PAGE){ if(flushIfDirty(pm,target)!=RC_OK){ attachFrame(pm,target); full=TRUE; break; } replacerRemove(&pm->repl,target); }
+            if(installFrame(pm,target,p,TRUE)!=RC_OK){ pm->freeFrames[pm->numFree++]=target; full=TRUE; break; }
+            IORequest *r=&pm->aheadReqs[target]; memset(r,0,sizeof(IORequest)); r->op=IO_READ; r->pageNum=p; r->buf=pm->frames[target].data; r->done=aheadComplete; r->userData=pm;
+            batch[n++]=r;
+        }
+        pthread_mutex_unlock(&pm->mtx); if(n>0) ioe_submitv(pm->io,batch,n);
+        if(full) return;
+    }
+}
+/** A thread's current pin stream; per thread, so interleaved clients do not break each other's runs. */
+typedef struct PinStream { PoolMgmt *pm; PageNumber last, aheadTo; int run; } PinStream;
+static _Thread_local PinStream pinStream;
+/** Called on every pin: once a thread pins consecutive pages, keep readAhead pages beyond it in flight, topped up half a window at a time. */
+static void readAheadFor(PoolMgmt *pm, PageNumber p){
+    PinStream *s=&pinStream; if(pm->readAhead<=0) return;
+    if(s->pm!=pm || p!=s->last+1){ if(s->pm!=pm || p!=s->last){ s->pm=pm; s->run=1; s->aheadTo=p+1; } s->last=p; return; }
+    s->last=p; if(++s->run<BM_SEQ_TRIGGER || s->aheadTo>p+pm->readAhead/2) return;
+    PageNumber from=(s->aheadTo>p+1)?s->aheadTo:p+1; s->aheadTo=p+1+pm->readAhead; prefetchRange(pm,from,s->aheadTo-from);
+}
 
 
+/* ==============================
+ * Background writer
+ *  Every BM_BGWRITER_INTERVAL_MS (or sooner, when a miss had to write a dirty victim) the writer looks at the
+ *  next bgTarget victims under the pool latch and writes the dirty ones after releasing it, each like forcePage
+ *  does: the frame latch is taken under the partition latch once the frame is seen to still hold the page.
+ * ============================== */
+/** Write back frame e->frame if it still holds e->page and is unpinned; TRUE if a page was written. */
+static bool bgClean(PoolMgmt *pm, const FlushEntry *e){
+    PagePartition *pt=partitionOf(pm,e->page); Frame *f=&pm->frames[e->frame];
+    pthread_mutex_lock(&pt->latch);
+    if(ptab_get(&pt->tab,e->page)!=e->frame || atomic_load(&f->fixCount)>0){ pthread_mutex_unlock(&pt->latch); return FALSE; }
+    pthread_mutex_lock(&f->latch); pthread_mutex_unlock(&pt->latch);
+    bool was=atomic_load(&f->dirty); RC rc=writeBackLocked(pm,e->frame,FALSE); pthread_mutex_unlock(&f->latch); return was && rc==RC_OK;
+}
+/** One round: write up to budget dirty frames among the next bgTarget victims, in eviction order; returns pages written. */
+static int bgRound(PoolMgmt *pm, int budget){
+    int k=0, written=0;
+    pthread_mutex_lock(&pm->mtx); drainEvents(pm);
+    int n=replacerCandidates(&pm->repl,pm->bgCand,pm->bgTarget);
+    for(int i=0;i<n;i++){ Frame *f=&pm->frames[pm->bgCand[i]]; if(atomic_load(&f->dirty)){ pm->bgDirty[k].page=f->pageNum; pm->bgDirty[k++].frame=pm->bgCand[i]; } }
+    pthread_mutex_unlock(&pm->mtx);
+    for(int i=0;i<k && written<budget;i++) written+=bgClean(pm,&pm->bgDirty[i]);
+    return written;
+}
+/** Writer thread: rounds paced by a token bucket of bgRate writes per second (at most one second's worth saved up). */
+static void *bgWriterMain(void *arg){
+    PoolMgmt *pm=(PoolMgmt*)arg; long long credit=0, cap=(pm->bgRate*BM_BGWRITER_INTERVAL_MS>1000)?(long long)pm->bgRate*BM_BGWRITER_INTERVAL_MS:1000; /* milli-writes */
+    pthread_mutex_lock(&pm->bgLock);
+    while(!pm->bgStop){
+        pthread_mutex_unlock(&pm->bgLock);
+        int budget=INT_MAX; if(pm->bgRate>0){ credit+=(long long)pm->bgRate*BM_BGWRITER_INTERVAL_MS; if(credit>cap) credit=cap; budget=(int)(credit/1000); }
+        int written=bgRound(pm,budget); if(pm->bgRate>0) credit-=1000LL*written;
+        struct timespec until; clock_gettime(CLOCK_MONOTONIC,&until); until.tv_nsec+=BM_BGWRITER_INTERVAL_MS*1000000L; if(until.tv_nsec>=1000000000L){ until.tv_sec++; until.tv_nsec-=1000000000L; }
+        pthread_mutex_lock(&pm->bgLock); if(!pm->bgStop) pthread_cond_timedwait(&pm->bgWake,&pm->bgLock,&until);
+    }
+    pthread_mutex_unlock(&pm->bgLock); return NULL;
+}
+static RC bgStart(PoolMgmt *pm){
+    pthread_condattr_t ca; pthread_condattr_init(&ca); pthread_condattr_setclock(&ca,CLOCK_MONOTONIC); pthread_cond_init(&pm->bgWake,&ca); pthread_condattr_destroy(&ca);
+    pthread_mutex_init(&pm->bgLock,NULL); pm->bgCand=malloc(sizeof(int)*pm->bgTarget); pm->bgDirty=malloc(sizeof(FlushEntry)*pm->bgTarget);
+    if(!pm->bgCand || !pm->bgDirty || pthread_create(&pm->bgThread,NULL,bgWriterMain,pm)!=0) return RC_WRITE_FAILED;
+    pm->bgRunning=TRUE; return RC_OK;
+}
+/** Stop and join the writer (if running); must not be called with the pool latch held. */
+static void bgStop(PoolMgmt *pm){
+    if(!pm->bgRunning) return;
+    pthread_mutex_lock(&pm->bgLock); pm->bgStop=TRUE; pthread_cond_signal(&pm->bgWake); pthread_mutex_unlock(&pm->bgLock);
+    pthread_join(pm->bgThread,NULL); pm->bgRunning=FALSE;
+}
+
+/* ==============================
+ * Reference trace
+ *  With BM_PoolOptions.traceFile every successful pin, unpin and markDirty (or logged change) is recorded
+ *  after the fact; trace.c buffers per thread, so recording takes no latch.
+ * ============================== */
+static void traceEvent(PoolMgmt *pm, TraceKind kind, PageNumber p){ if(pm->trace) trace_record(pm->trace,kind,p); }
+
+/* ==============================
+ * Double-write area
+ *  With BM_PoolOptions.doubleWriteFile every write-back goes through the side file first (writeFrames): a batch is
+ *  written there sequentially and synced before its pages are written in place, so a crash cannot leave a torn page
+ *  without an intact copy. Init puts those copies back; a clean shutdown empties the area.
+ * ============================== */
+/** Open the area and repair the pages a crash may have torn during the last batch's home writes (before the log is replayed over them). */
+static RC openDoubleWrite(PoolMgmt *pm, const char *file){ RC rc=dw_open(&pm->dw,file); return (rc==RC_OK)?dw_recover(pm->dw,&pm->fhandle,NULL):rc; }
+
+/* ==============================
+ * Write-ahead log
+ *  With BM_PoolOptions.walFile, clients log each change of a pinned page (logPageImage/logPageUpdate) before
+ *  unpinning it. The record's LSN becomes the frame's lsn, and every write-back first flushes the log through
+ *  the lsn of the pages it writes (logCovers). Recovery is redo: init replays the log into the page file.
+ *  A change may be made before it is logged, so the pool writes a page on its own only while it is unpinned:
+ *  evictions, flushes, checkpoints and the background writer skip pinned pages, and so does shutdown. A page
+ *  left pinned keeps its logged changes in the log instead (from its recLSN on). forcePage writes the page as
+ *  it is, because the caller asks for it.
+ * ============================== */
+/** Open the log and redo it into the page file (the last run may have crashed before writing its pages); the page file is synced, so the log starts out empty. */
+static RC openLog(PoolMgmt *pm, const char *walFile){ RC rc=wal_open(&pm->wal,walFile); if(rc==RC_OK) rc=wal_replay(pm->wal,&pm->fhandle,NULL); if(rc==RC_OK) rc=wal_reset(pm->wal); return rc; }
+/**
+ * Clean shutdown, after the final flush: once the page file is synced it holds every logged change but those of pages
+ * left pinned, which were not written. The log is emptied, or if such pages are dirty, checkpointed at the oldest recLSN.
+ */
+static RC closeLog(PoolMgmt *pm){
+    if(!pm->wal) return RC_OK;
+    RC rc=syncFile(&pm->fhandle); if(rc!=RC_OK) return rc;
+    LSN redo=wal_endLSN(pm->wal); bool kept=FALSE;
+    for(int i=0;i<pm->capacity;i++){ Frame *f=&pm->frames[i]; pthread_mutex_lock(&f->latch); if(f->pageNum!=NO_PAGE && atomic_load(&f->dirty) && f->recLSN>=0){ kept=TRUE; if(f->recLSN<redo) redo=f->recLSN; } pthread_mutex_unlock(&f->latch); }
+    return kept?wal_checkpoint(pm->wal,redo,NULL):wal_reset(pm->wal);
+}
+/** Log bytes [offset, offset+length) of a resident page and make the record its lsn, under the frame latch so a write-back sees both or neither. */
+static RC logChange(PoolMgmt *pm, PageNumber p, int offset, int length, LSN *lsn){
+    PagePartition *pt=partitionOf(pm,p); pthread_mutex_lock(&pt->latch); int idx=ptab_get(&pt->tab,p);
+    if(idx<0){ pthread_mutex_unlock(&pt->latch); return RC_READ_NON_EXISTING_PAGE; }
+    Frame *f=&pm->frames[idx]; pthread_mutex_lock(&f->latch); pthread_mutex_unlock(&pt->latch);
+    if(f->recLSN<0) f->recLSN=wal_endLSN(pm->wal); /* at or before the record's start */
+    atomic_store(&f->dirty,TRUE); /* before the append: a checkpoint that starts after the record sees the page dirty */
+    LSN l; RC rc=wal_append(pm->wal,p,offset,length,f->data+offset,&l);
+    if(rc==RC_OK){ f->lsn=l; if(lsn) *lsn=l; }
+    pthread_mutex_unlock(&f->latch); return rc;
+}
+
+/* ==============================
+ * Fuzzy checkpoints
+ *  checkpointPool snapshots the dirty set under the pool latch (a scan, no I/O) and writes it with the pool latch
+ *  released, BM_FLUSH_RUN pages per write, while pins, misses and evictions go on. A page pinned when its write
+ *  would start is skipped, as it may hold a change not logged yet; the redo LSN moves back to its recLSN, so
+ *  recovery still redoes its logged changes. A batch takes a frame only if its partition and frame latches are
+ *  free and it still holds the page, so it never waits for a latch while holding others; the rest are written
+ *  one by one afterwards. Then the checkpoint waits out write-backs that cleaned a page before the scan, syncs
+ *  the page file and logs the checkpoint record, from which recovery replays.
+ * ============================== */
+/**
+ * Latch e's frame if it still holds e->page unpinned: 1 latched, 0 no longer there or pinned, -1 a latch was busy
+ * (only if !wait). The pin check is made under the partition latch, so no pin comes in between; a pinned page
+ * moves the checkpoint's redo LSN back to its recLSN.
+ */
+static int latchToWrite(PoolMgmt *pm, const FlushEntry *e, bool wait){
+    PagePartition *pt=partitionOf(pm,e->page); Frame *f=&pm->frames[e->frame]; int got=0;
+    if(wait) pthread_mutex_lock(&pt->latch); else if(pthread_mutex_trylock(&pt->latch)!=0) return -1;
+    if(ptab_get(&pt->tab,e->page)==e->frame){ if(wait) pthread_mutex_lock(&f->latch); got=(wait || pthread_mutex_trylock(&f->latch)==0)?1:-1; }
+    if(got>0 && atomic_load(&f->fixCount)>0){ if(f->recLSN>=0 && f->recLSN<pm->ckptRedo) pm->ckptRedo=f->recLSN; pthread_mutex_unlock(&f->latch); got=0; }
+    pthread_mutex_unlock(&pt->latch); return got;
+}
+/** Write one batch of snapshot entries (page order): the frames latched without waiting in one write, the others one at a time. */
+static RC checkpointBatch(PoolMgmt *pm, const FlushEntry *e, int n){
+    int held[BM_FLUSH_RUN], dirty[BM_FLUSH_RUN], busy[BM_FLUSH_RUN], nh=0, nd=0, nb=0;
+    for(int i=0;i<n;i++){ int got=latchToWrite(pm,&e[i],FALSE); if(got>0) held[nh++]=e[i].frame; else if(got<0) busy[nb++]=i; }
+    for(int i=0;i<nh;i++) if(atomic_exchange(&pm->frames[held[i]].dirty,FALSE)) dirty[nd++]=held[i];
+    RC rc=writeFrames(pm,dirty,nd,-1);
+    for(int i=0;i<nh;i++) pthread_mutex_unlock(&pm->frames[held[i]].latch);
+    for(int i=0;i<nb && rc==RC_OK;i++){ if(latchToWrite(pm,&e[busy[i]],TRUE)>0){ rc=writeBackLocked(pm,e[busy[i]].frame,FALSE); pthread_mutex_unlock(&pm->frames[e[busy[i]].frame].latch); } }
+    return rc;
+}
+/** Wait for write-backs in progress: those under a frame latch (forcePage, background writer) and evictions under the pool latch. */
+static void awaitWriteBacks(PoolMgmt *pm){
+    for(int i=0;i<pm->capacity;i++){ pthread_mutex_lock(&pm->frames[i].latch); pthread_mutex_unlock(&pm->frames[i].latch); }
+    pthread_mutex_lock(&pm->mtx); pthread_mutex_unlock(&pm->mtx);
+}
+
 /* ==============================
  * Public API — Buffer Pool
  * ============================== */
@@ -98,98 +580,252 @@ static RC loadIntoFrame(PoolMgmt *pm, int idx, PageNumber p){ Frame *f=&pm->fram
 /**
  * initBufferPool
  *  - Open backing page file
- *  - Allocate frames and snapshots
- *  - Initialize page table and mutex
+ *  - Allocate frames; their data is one page-aligned arena (huge pages / NUMA node per BM_PoolOptions)
+ *    (statistics snapshots are allocated lazily by the getters)
+ *  - Initialize partitioned page table and latches
 */
-RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, const int numPages, ReplacementStrategy strategy, void *stratData){
-    (void)stratData; if(!bm||!pageFileName||numPages<=0){ THROW(RC_FILE_HANDLE_NOT_INIT,"initBufferPool: invalid arguments"); }
-    PoolMgmt *pm=(PoolMgmt*)calloc(1,sizeof(PoolMgmt)); if(!pm) THROW(RC_WRITE_FAILED,"initBufferPool: OOM");
-    RC rc=openPageFile((char*)pageFileName,&pm->fhandle); if(rc!=RC_OK){ free(pm); return rc; }
-    pm->capacity=numPages; pm->strategy=(strategy==RS_LRU_K)?RS_LRU:strategy; pm->tick=0; pm->numReadIO=0; pm->numWriteIO=0; pm->clockHand=0; pm->open=TRUE; pthread_mutex_init(&pm->mtx,NULL);
-    pm->frames=(Frame*)calloc(numPages,sizeof(Frame)); pm->frameContents=malloc(sizeof(PageNumber)*numPages); pm->dirtyFlags=malloc(sizeof(bool)*numPages); pm->fixCounts=malloc(sizeof(int)*numPages);
-    if(!pm->frames||!pm->frameContents||!pm->dirtyFlags||!pm->fixCounts){ if(pm->frames) free(pm->frames); if(pm->frameContents) free(pm->frameContents); if(pm->dirtyFlags) free(pm->dirtyFlags); if(pm->fixCounts) free(pm->fixCounts); closePageFile(&pm->fhandle); pthread_mutex_destroy(&pm->mtx); free(pm); THROW(RC_WRITE_FAILED,"initBufferPool: OOM (arrays)"); }
-    for(int i=0;i<numPages;i++){ pm->frames[i].pageNum=NO_PAGE; pm->frames[i].data=(char*)calloc(PAGE_SIZE,1); pm->frames[i].dirty=FALSE; pm->frames[i].fixCount=0; pm->frames[i].lastUsed=0; pm->frames[i].fifoPos=0; pm->frames[i].refbit=FALSE; if(!pm->frames[i].data){ for(int j=0;j<i;j++) free(pm->frames[j].data); free(pm->frames); free(pm->frameContents); free(pm->dirtyFlags); free(pm->fixCounts); closePageFile(&pm->fhandle); pthread_mutex_destroy(&pm->mtx); free(pm); THROW(RC_WRITE_FAILED,"initBufferPool: OOM (frame buffers)"); } }
-    rc=ptab_init(&pm->ptab,numPages); if(rc!=RC_OK){ for(int i=0;i<numPages;i++) free(pm->frames[i].data); free(pm->frames); free(pm->frameContents); free(pm->dirtyFlags); free(pm->fixCounts); closePageFile(&pm->fhandle); pthread_mutex_destroy(&pm->mtx); free(pm); return rc; }
-    bm->pageFile=(char*)pageFileName; bm->numPages=numPages; bm->strategy=strategy; bm->mgmtData=pm; refreshSnapshots(pm); return RC_OK;
+/** Release everything a (possibly half-built) pool owns; pm came from calloc, so missing parts are NULL. */
+static void destroyPool(PoolMgmt *pm){
+    bgStop(pm);
+    if(pm->bgTarget>0){ pthread_cond_destroy(&pm->bgWake); pthread_mutex_destroy(&pm->bgLock); free(pm->bgCand); free(pm->bgDirty); }
+    ioe_free(pm->io); /* waits for prefetches in flight, whose completions use the frames */
+    wal_close(pm->wal); dw_close(pm->dw); trace_close(pm->trace);
+    if(pm->frames){ for(int i=0;i<pm->capacity;i++){ pthread_mutex_destroy(&pm->frames[i].latch); } }
+    arena_free(&pm->arena);
+    if(pm->parts) parts_free(pm);
+    replacerFree(&pm->repl);
+    free(pm->frames); free(pm->frameContents); free(pm->dirtyFlags); free(pm->fixCounts); free(pm->drainBuf); free(pm->freeFrames); free(pm->aheadReqs); free(pm->aheadNext); free(pm->flushBuf); free(pm->ckptBuf);
+    if(pm->fhandle.mgmtInfo) closePageFile(&pm->fhandle);
+    pthread_mutex_destroy(&pm->ckptLock); pthread_mutex_destroy(&pm->mtx); free(pm);
+}
+void initPoolOptions(BM_PoolOptions *const opts){ if(!opts) return; memset(opts,0,sizeof(BM_PoolOptions)); opts->numaNode=-1; }
+RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, const int numPages, ReplacementStrategy strategy, void *stratData){ return initBufferPoolWithOptions(bm,pageFileName,numPages,strategy,stratData,NULL); }
+RC initBufferPoolWithOptions(BM_BufferPool *const bm, const char *const pageFileName, const int numPages, ReplacementStrategy strategy, void *stratData, const BM_PoolOptions *const opts){
+    BM_PoolOptions o; if(opts) o=*opts; else initPoolOptions(&o);
+    if(!bm||!pageFileName||numPages<=0){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"initBufferPool: invalid arguments",NO_PAGE,bm); }
+    if(strategy==RS_LRU_K && stratData && *(const int*)stratData<1){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"initBufferPool: LRU-K needs K >= 1",NO_PAGE,bm); }
+    PoolMgmt *pm=(PoolMgmt*)calloc(1,sizeof(PoolMgmt)); if(!pm) THROW_AT(RC_WRITE_FAILED,"initBufferPool: OOM",NO_PAGE,bm);
+    pthread_mutex_init(&pm->mtx,NULL); pthread_mutex_init(&pm->ckptLock,NULL);
+    const char *why="initBufferPool: cannot open the page file"; RC rc=openPageFile((char*)pageFileName,&pm->fhandle);
+    if(rc==RC_OK){ why="initBufferPool: cannot set the write mode or growth policy"; rc=setWriteMode(&pm->fhandle,o.writeMode); if(rc==RC_OK) rc=setGrowthPolicy(&pm->fhandle,o.growPages,o.growPercent); }
+    if(rc==RC_OK && o.doubleWriteFile){ why="initBufferPool: cannot open or recover the double-write area"; rc=openDoubleWrite(pm,o.doubleWriteFile); }
+    if(rc==RC_OK && o.walFile){ why="initBufferPool: cannot open or replay the write-ahead log"; rc=openLog(pm,o.walFile); }
+    if(rc==RC_OK){ why="initBufferPool: cannot start the I/O engine"; rc=ioe_init(&pm->io,&pm->fhandle,o.ioBackend,o.ioDepth,o.ioWorkers); }
+    if(rc==RC_OK && o.traceFile){ why="initBufferPool: cannot create the trace file"; rc=trace_open(&pm->trace,o.traceFile); }
+    if(rc!=RC_OK){ destroyPool(pm); THROW_AT(rc,why,NO_PAGE,bm); }
+    pm->capacity=numPages; pm->strategy=strategy; atomic_init(&pm->tick,0); atomic_init(&pm->numReadIO,0); atomic_init(&pm->numWriteIO,0); pm->open=TRUE;
+    pm->readAhead=(o.readAhead<numPages/2)?o.readAhead:numPages/2; atomic_init(&pm->aheadDone,-1);
+    pm->frames=(Frame*)calloc(numPages,sizeof(Frame)); pm->freeFrames=malloc(sizeof(int)*numPages); pm->aheadReqs=calloc(numPages,sizeof(IORequest)); pm->aheadNext=malloc(sizeof(int)*numPages); pm->flushBuf=malloc(sizeof(FlushEntry)*numPages); pm->ckptBuf=malloc(sizeof(FlushEntry)*numPages);
+    if(!pm->frames||!pm->freeFrames||!pm->aheadReqs||!pm->aheadNext||!pm->flushBuf||!pm->ckptBuf){ destroyPool(pm); THROW_AT(RC_WRITE_FAILED,"initBufferPool: OOM (arrays)",NO_PAGE,bm); }
+    for(int i=0;i<numPages;i++){ Frame *f=&pm->frames[i]; f->pageNum=NO_PAGE; f->recLSN=-1; atomic_init(&f->dirty,FALSE); atomic_init(&f->loading,LOAD_IDLE); atomic_init(&f->fixCount,0); pthread_mutex_init(&f->latch,NULL); }
+    if(arena_init(&pm->arena,numPages,o.hugePages,o.numaNode)!=RC_OK){ destroyPool(pm); THROW_AT(RC_WRITE_FAILED,"initBufferPool: OOM (frame arena)",NO_PAGE,bm); }
+    for(int i=0;i<numPages;i++) pm->frames[i].data=pm->arena.base+(size_t)i*PAGE_SIZE;
+    for(int i=numPages-1;i>=0;i--) pm->freeFrames[pm->numFree++]=i; /* frame 0 is handed out first */
+    if((rc=parts_init(pm,numPages))!=RC_OK || (rc=replacerInit(&pm->repl,strategy,numPages,stratData))!=RC_OK){ destroyPool(pm); THROW_AT(rc,"initBufferPool: cannot set up the page table or replacer",NO_PAGE,bm); }
+    if(!(pm->drainBuf=malloc(sizeof(AccessEvent)*BM_EVENT_BATCH*pm->numParts))){ destroyPool(pm); THROW_AT(RC_WRITE_FAILED,"initBufferPool: OOM (event buffer)",NO_PAGE,bm); }
+    pm->bgTarget=(o.bgCleanTarget<numPages)?o.bgCleanTarget:numPages; pm->bgRate=(o.bgMaxRate>0)?o.bgMaxRate:0;
+    if(pm->bgTarget>0 && bgStart(pm)!=RC_OK){ destroyPool(pm); THROW_AT(RC_WRITE_FAILED,"initBufferPool: cannot start the background writer",NO_PAGE,bm); }
+    bm->pageFile=(char*)pageFileName; bm->numPages=numPages; bm->strategy=strategy; bm->mgmtData=pm; return RC_OK;
 }
 /**
  * shutdownBufferPool
- *  - DEFENSIVE: release any leftover pins
- *  - Flush all dirty frames
+ *  - Stop the background writer, if any
+ *  - Flush all dirty frames in page order, adjacent pages with one write (one sync for the batch in SM_WRITE_SYNC_ON_FLUSH mode)
+ *  - With a write-ahead log: sync the page file and empty the log; with a double-write area: empty it
  *  - Free all allocations and close file
  *
  * Note: The assignment typically errors if pages are pinned at shutdown.
- * Here we auto-unpin to keep shutdown robust for demos/tests and avoid
- * leaking resources in case of client imbalances.
+ * Here leftover pins are dropped to keep shutdown robust for demos/tests and
+ * avoid leaking resources in case of client imbalances. Without a log, pages
+ * still pinned are written like the others. With one they are not, as they may
+ * hold changes not logged yet: their logged changes stay in the log, which is
+ * checkpointed instead of emptied and redone at the next init.
  */
 RC shutdownBufferPool(BM_BufferPool *const bm){
-    if(!bm || !bm->mgmtData){ THROW(RC_FILE_HANDLE_NOT_INIT,"shutdownBufferPool: pool not initialized"); }
-    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx);
-    /* Defensive release: if any pages remain pinned, gracefully unpin them instead of failing.
-       This avoids lingering fixCount due to client/test imbalance and allows clean shutdown. */
-    for(int i=0;i<pm->capacity;i++){ if(pm->frames[i].fixCount>0) pm->frames[i].fixCount=0; }
-    for(int i=0;i<pm->capacity;i++){ RC rc=flushIfDirty(pm,i); if(rc!=RC_OK){ pthread_mutex_unlock(&pm->mtx); return rc; } }
-    for(int i=0;i<pm->capacity;i++){ free(pm->frames[i].data); }
-    free(pm->frames); free(pm->frameContents); free(pm->dirtyFlags); free(pm->fixCounts); ptab_free(&pm->ptab);
-    closePageFile(&pm->fhandle); pm->open=FALSE; pthread_mutex_unlock(&pm->mtx); pthread_mutex_destroy(&pm->mtx); free(pm); bm->mgmtData=NULL; return RC_OK;
+    if(!bm || !bm->mgmtData){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"shutdownBufferPool: pool not initialized",NO_PAGE,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; bgStop(pm); pthread_mutex_lock(&pm->mtx);
+    int written=atomic_load(&pm->numWriteIO);
+    RC rc=flushPool(pm,!pm->wal); /* pinned pages too unless the log holds their changes */ if(rc==RC_OK) rc=syncBatch(pm,written); if(rc==RC_OK) rc=closeLog(pm); if(rc==RC_OK && pm->dw) rc=dw_reset(pm->dw); if(rc!=RC_OK){ pthread_mutex_unlock(&pm->mtx); THROW_AT(rc,"shutdownBufferPool: cannot write back the pool",NO_PAGE,bm); }
+    pm->open=FALSE; pthread_mutex_unlock(&pm->mtx); destroyPool(pm); bm->mgmtData=NULL; return RC_OK;
 }
 /**
  * forceFlushPool
- *  - Write back all frames that are dirty AND not currently pinned.
+ *  - Write back all frames that are dirty AND not currently pinned, sorted by page; runs of adjacent pages go out as one vectored write.
+ *  - In SM_WRITE_SYNC_ON_FLUSH mode, one sync after the batch makes it durable.
  *  - Does not evict or modify pin state.
  */
 RC forceFlushPool(BM_BufferPool *const bm){
-    if(!bm || !bm->mgmtData){ THROW(RC_FILE_HANDLE_NOT_INIT,"forceFlushPool: pool not initialized"); }
-    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx);
-    for(int i=0;i<pm->capacity;i++){ if(pm->frames[i].fixCount==0){ RC rc=flushIfDirty(pm,i); if(rc!=RC_OK){ pthread_mutex_unlock(&pm->mtx); return rc; } } }
-    refreshSnapshots(pm); pthread_mutex_unlock(&pm->mtx); return RC_OK;
+    if(!bm || !bm->mgmtData){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"forceFlushPool: pool not initialized",NO_PAGE,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx); int written=atomic_load(&pm->numWriteIO);
+    RC rc=flushPool(pm,FALSE); if(rc==RC_OK) rc=syncBatch(pm,written); pthread_mutex_unlock(&pm->mtx);
+    if(rc!=RC_OK){ THROW_AT(rc,"forceFlushPool: cannot write back the pool",NO_PAGE,bm); } return RC_OK;
+}
+
+/**
+ * checkpointPool — a fuzzy checkpoint: write every page that is dirty now and unpinned when its turn comes, without
+ * holding the pool latch for the I/O, so pins and misses continue meanwhile. Ends with a sync of the page file and,
+ * with a write-ahead log, a checkpoint record: recovery then only replays what was logged after the checkpoint began,
+ * or since the oldest unwritten change of a page the checkpoint skipped because it was pinned.
+ */
+RC checkpointPool(BM_BufferPool *const bm){
+    if(!bm || !bm->mgmtData){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"checkpointPool: pool not initialized",NO_PAGE,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; int n=0; RC rc=RC_OK;
+    pthread_mutex_lock(&pm->ckptLock);
+    pthread_mutex_lock(&pm->mtx);
+    pm->ckptRedo=pm->wal?wal_endLSN(pm->wal):0; /* read before the scan: the page of every earlier record is dirty or being written */
+    for(int i=0;i<pm->capacity;i++){ Frame *f=&pm->frames[i]; if(f->pageNum!=NO_PAGE && atomic_load(&f->dirty)){ pm->ckptBuf[n].page=f->pageNum; pm->ckptBuf[n++].frame=i; } }
+    pthread_mutex_unlock(&pm->mtx);
+    qsort(pm->ckptBuf,n,sizeof(FlushEntry),cmpFlushPage);
+    for(int i=0;i<n && rc==RC_OK;i+=BM_FLUSH_RUN) rc=checkpointBatch(pm,pm->ckptBuf+i,(n-i<BM_FLUSH_RUN)?n-i:BM_FLUSH_RUN);
+    if(rc==RC_OK){ awaitWriteBacks(pm); if(!pm->dw) rc=syncFile(&pm->fhandle); } /* double-write batches are synced already */
+    if(rc==RC_OK && pm->wal) rc=wal_checkpoint(pm->wal,pm->ckptRedo,NULL);
+    pthread_mutex_unlock(&pm->ckptLock);
+    if(rc!=RC_OK){ THROW_AT(rc,"checkpointPool: cannot write back the pool or log the checkpoint",NO_PAGE,bm); } return RC_OK;
 }
 
 /* ==============================
  * Public API — Per-page operations
+ *  Hits, unpins, markDirty and forcePage only take the page's partition latch (plus the
+ *  pool latch now and then to apply a full event batch); misses and whole-pool operations take the pool latch.
  * ============================== */
 
 /** Mark page as dirty; page must currently be in the pool. */
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page){
-    if(!bm || !bm->mgmtData || !page){ THROW(RC_FILE_HANDLE_NOT_INIT,"markDirty: invalid arguments"); }
-    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx);
-    int idx=ptab_get(&pm->ptab,page->pageNum); if(idx<0){ pthread_mutex_unlock(&pm->mtx); THROW(RC_READ_NON_EXISTING_PAGE,"markDirty: page not in pool"); }
-    pm->frames[idx].dirty=TRUE; refreshSnapshots(pm); pthread_mutex_unlock(&pm->mtx); return RC_OK;
+    if(!bm || !bm->mgmtData || !page){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"markDirty: invalid arguments",NO_PAGE,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData;
+    if(withResident(pm,page->pageNum,op_dirty)<0){ THROW_AT(RC_READ_NON_EXISTING_PAGE,"markDirty: page not in pool",page->pageNum,bm); }
+    traceEvent(pm,TR_DIRTY,page->pageNum); return RC_OK;
 }
 
 RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page){
-    if(!bm || !bm->mgmtData || !page){ THROW(RC_FILE_HANDLE_NOT_INIT,"unpinPage: invalid arguments"); }
-    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx);
-    int idx=ptab_get(&pm->ptab,page->pageNum); if(idx<0){ pthread_mutex_unlock(&pm->mtx); THROW(RC_READ_NON_EXISTING_PAGE,"unpinPage: page not in pool"); }
-    if (pm->frames[idx].fixCount > 0) {
-        pm->frames[idx].fixCount -= 1;
-    }
-    refreshSnapshots(pm);
-    pthread_mutex_unlock(&pm->mtx);
-    return RC_OK;
+    if(!bm || !bm->mgmtData || !page){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"unpinPage: invalid arguments",NO_PAGE,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData;
+    if(unpinIfResident(pm,page->pageNum,FALSE)<0){ THROW_AT(RC_READ_NON_EXISTING_PAGE,"unpinPage: page not in pool",page->pageNum,bm); }
+    traceEvent(pm,TR_UNPIN,page->pageNum); return RC_OK;
 }
 
+/**
+ * forcePage — write the page back now. The frame latch is taken before the partition latch is released,
+ * so an evictor that detaches the frame meanwhile waits for this write instead of racing it.
+ */
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page){
-    if(!bm || !bm->mgmtData || !page){ THROW(RC_FILE_HANDLE_NOT_INIT,"forcePage: invalid arguments"); }
-    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx);
-    int idx=ptab_get(&pm->ptab,page->pageNum); if(idx<0){ pthread_mutex_unlock(&pm->mtx); THROW(RC_READ_NON_EXISTING_PAGE,"forcePage: page not in pool"); }
-    RC rc=flushIfDirty(pm,idx); if(rc!=RC_OK){ pthread_mutex_unlock(&pm->mtx); return rc; } refreshSnapshots(pm); pthread_mutex_unlock(&pm->mtx); return RC_OK;
+    if(!bm || !bm->mgmtData || !page){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"forcePage: invalid arguments",NO_PAGE,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; PagePartition *pt=partitionOf(pm,page->pageNum);
+    pthread_mutex_lock(&pt->latch); int idx=ptab_get(&pt->tab,page->pageNum);
+    if(idx<0){ pthread_mutex_unlock(&pt->latch); THROW_AT(RC_READ_NON_EXISTING_PAGE,"forcePage: page not in pool",page->pageNum,bm); }
+    pthread_mutex_lock(&pm->frames[idx].latch); pthread_mutex_unlock(&pt->latch); int written=atomic_load(&pm->numWriteIO);
+    RC rc=writeBackLocked(pm,idx,FALSE); pthread_mutex_unlock(&pm->frames[idx].latch); if(rc==RC_OK) rc=syncBatch(pm,written);
+    if(rc!=RC_OK){ THROW_AT(rc,"forcePage: cannot write back the page",page->pageNum,bm); } return RC_OK;
 }
 
+/** Hand out a pinned frame, once any read of it in flight has completed. */
+static RC pinned(PoolMgmt *pm, BM_PageHandle *const page, PageNumber p, int idx){ awaitLoad(pm,&pm->frames[idx],p); traceEvent(pm,TR_PIN,p); page->pageNum=p; page->data=pm->frames[idx].data; return RC_OK; }
+
+/** The miss path of pinPage: take the pool latch, bring the replacer up to date, re-check (another thread may have installed the page), then evict/install and read. */
+static RC pinMiss(BM_BufferPool *const bm, BM_PageHandle *const page, PageNumber pageNum){
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData;
+    lockPoolForPin(pm,pageNum); drainEvents(pm);
+    int idx=pinIfResident(pm,pageNum,TRUE);
+    if(idx>=0){ pthread_mutex_unlock(&pm->mtx); return pinned(pm,page,pageNum,idx); }
+    int target=(pm->numFree>0)?pm->freeFrames[--pm->numFree]:-1;
+    if(target<0){
+        target=claimVictim(pm,pageNum); if(target<0){ pthread_mutex_unlock(&pm->mtx); THROW_AT(RC_WRITE_FAILED,"pinPage: no replaceable frame (all pinned)",pageNum,bm); }
+        if(pm->bgRunning && atomic_load(&pm->frames[target].dirty)) pthread_cond_signal(&pm->bgWake); /* the writer is behind */
+        RC rc=flushIfDirty(pm,target); if(rc!=RC_OK){ attachFrame(pm,target); pthread_mutex_unlock(&pm->mtx); THROW_AT(rc,"pinPage: cannot write back the victim",pageNum,bm); } replacerRemove(&pm->repl,target);
+    }
+    RC rc=installFrame(pm,target,pageNum,FALSE); if(rc!=RC_OK){ pm->freeFrames[pm->numFree++]=target; pthread_mutex_unlock(&pm->mtx); THROW_AT(rc,"pinPage: cannot extend the page file",pageNum,bm); }
+    statAdd(&pm->stats.misses,1); pthread_mutex_unlock(&pm->mtx); readIntoFrame(pm,target); traceEvent(pm,TR_PIN,pageNum);
+    page->pageNum=pageNum; page->data=pm->frames[target].data; return RC_OK;
+}
+/**
+ * pinPage — a hit pins under the partition latch only. A miss picks and installs a frame under the pool latch,
+ * then reads the page with no latch held; concurrent pinners of the same page find the installed frame and wait
+ * for that one read, so each miss costs a single read however many threads ask for the page.
+ */
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum){
-    if(!bm || !bm->mgmtData || !page){ THROW(RC_FILE_HANDLE_NOT_INIT,"pinPage: invalid arguments"); }
-    if(pageNum<0){ THROW(RC_READ_NON_EXISTING_PAGE,"pinPage: negative page number"); }
+    if(!bm || !bm->mgmtData || !page){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"pinPage: invalid arguments",pageNum,bm); }
+    if(pageNum<0){ THROW_AT(RC_READ_NON_EXISTING_PAGE,"pinPage: negative page number",pageNum,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; PROBE_START(t);
+    readAheadFor(pm,pageNum);
+    int idx=pinIfResident(pm,pageNum,FALSE);
+    RC rc=(idx>=0)?pinned(pm,page,pageNum,idx):pinMiss(bm,page,pageNum);
+    PROBE_END(t,PROBE_PIN,pageNum); return rc; /* pinMiss records its own failures */
+}
+
+/**
+ * prefetchPages — start reading pages [start, start+count) that are not in the pool, without pinning them.
+ * Pages past the end of the file are skipped, and at most numPages pages are read. Returns before the reads
+ * complete; pinning a page that is still being read waits for it. Prefetched pages that are then used once
+ * are the first to be evicted.
+ */
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber start, const int count){
+    if(!bm || !bm->mgmtData || count<0){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"prefetchPages: invalid arguments",start,bm); }
+    if(start<0){ THROW_AT(RC_READ_NON_EXISTING_PAGE,"prefetchPages: negative page number",start,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; prefetchRange(pm,start,(count<pm->capacity)?count:pm->capacity); return RC_OK;
+}
+
+/**
+ * logPageUpdate — append a log record holding bytes [offset, offset+length) of a pinned page as they are now,
+ * and mark the page dirty. Call it after changing the page and before unpinning it: the page is not written
+ * back until the log is durable through the record's LSN (*lsn, optional), and while it stays pinned the pool
+ * does not write it at all (forcePage aside), so no change reaches the page file before it is logged.
+ * A transaction commits with flushLog.
+ */
+RC logPageUpdate (BM_BufferPool *const bm, BM_PageHandle *const page, const int offset, const int length, LSN *lsn){
+    if(!bm || !bm->mgmtData || !page || offset<0 || length<0 || offset>PAGE_SIZE || length>PAGE_SIZE-offset){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"logPageUpdate: invalid arguments",NO_PAGE,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData;
+    if(!pm->wal){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"logPageUpdate: pool has no write-ahead log",page->pageNum,bm); }
+    RC rc=logChange(pm,page->pageNum,offset,length,lsn);
+    if(rc==RC_READ_NON_EXISTING_PAGE){ THROW_AT(rc,"logPageUpdate: page not in pool",page->pageNum,bm); }
+    if(rc!=RC_OK){ THROW_AT(rc,"logPageUpdate: cannot append the log record",page->pageNum,bm); }
+    traceEvent(pm,TR_DIRTY,page->pageNum); return RC_OK;
+}
+/** logPageImage — logPageUpdate for the whole page (a page image record). */
+RC logPageImage (BM_BufferPool *const bm, BM_PageHandle *const page, LSN *lsn){ return logPageUpdate(bm,page,0,PAGE_SIZE,lsn); }
+/** flushLog — group commit: concurrent callers share one log write and sync. */
+RC flushLog (BM_BufferPool *const bm, const LSN upTo){
+    if(!bm || !bm->mgmtData){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"flushLog: pool not initialized",NO_PAGE,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData;
+    if(!pm->wal){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"flushLog: pool has no write-ahead log",NO_PAGE,bm); }
+    RC rc=wal_flush(pm->wal,upTo); if(rc!=RC_OK){ THROW_AT(rc,"flushLog: cannot write or sync the log",NO_PAGE,bm); } return RC_OK;
+}
+
+/* ==============================
+ * Statistics Interface
+ *  The snapshot arrays are allocated on first use and filled only when a getter is called,
+ *  so pin/unpin/markDirty never pay O(numPages) for them. getPoolStats reads the counters without latching:
+ *  a hit bumps its partition's counter (a cache line it owns anyway), everything else is counted off the hit path.
+ * ============================== */
+PageNumber *getFrameContents (BM_BufferPool *const bm){
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx);
+    if(!pm->frameContents) pm->frameContents=malloc(sizeof(PageNumber)*pm->capacity);
+    if(pm->frameContents){ for(int i=0;i<pm->capacity;i++) pm->frameContents[i]=pm->frames[i].pageNum; }
+    pthread_mutex_unlock(&pm->mtx); return pm->frameContents;
+}
+bool *getDirtyFlags (BM_BufferPool *const bm){
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx);
+    if(!pm->dirtyFlags) pm->dirtyFlags=malloc(sizeof(bool)*pm->capacity);
+    if(pm->dirtyFlags){ for(int i=0;i<pm->capacity;i++) pm->dirtyFlags[i]=atomic_load(&pm->frames[i].dirty)?TRUE:FALSE; }
+    pthread_mutex_unlock(&pm->mtx); return pm->dirtyFlags;
+}
+int *getFixCounts (BM_BufferPool *const bm){
     PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx);
-    pm->tick += 1;
-    int idx=ptab_get(&pm->ptab,pageNum);
-    if(idx>=0){ Frame *f=&pm->frames[idx]; f->fixCount+=1; f->lastUsed=pm->tick; f->refbit=TRUE; page->pageNum=pageNum; page->data=f->data; refreshSnapshots(pm); pthread_mutex_unlock(&pm->mtx); return RC_OK; }
-    int target=findEmptyFrame(pm); if(target<0){ target=selectVictim(pm); if(target<0){ pthread_mutex_unlock(&pm->mtx); THROW(RC_WRITE_FAILED,"pinPage: no replaceable frame (all pinned)"); } RC rc=flushIfDirty(pm,target); if(rc!=RC_OK){ pthread_mutex_unlock(&pm->mtx); return rc; } if(pm->frames[target].pageNum!=NO_PAGE) ptab_del(&pm->ptab, pm->frames[target].pageNum); }
-    RC rc=loadIntoFrame(pm,target,pageNum); if(rc!=RC_OK){ pthread_mutex_unlock(&pm->mtx); return rc; }
-    pm->frames[target].fixCount=1; pm->frames[target].lastUsed=pm->tick; pm->frames[target].refbit=TRUE; page->pageNum=pageNum; page->data=pm->frames[target].data; refreshSnapshots(pm); pthread_mutex_unlock(&pm->mtx); return RC_OK;
-}
-
-PageNumber *getFrameContents (BM_BufferPool *const bm){ PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx); refreshSnapshots(pm); pthread_mutex_unlock(&pm->mtx); return pm->frameContents; }
-bool *getDirtyFlags (BM_BufferPool *const bm){ PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx); refreshSnapshots(pm); pthread_mutex_unlock(&pm->mtx); return pm->dirtyFlags; }
-int *getFixCounts (BM_BufferPool *const bm){ PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; pthread_mutex_lock(&pm->mtx); refreshSnapshots(pm); pthread_mutex_unlock(&pm->mtx); return pm->fixCounts; }
-int getNumReadIO (BM_BufferPool *const bm){ PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; return pm->numReadIO; }
-int getNumWriteIO (BM_BufferPool *const bm){ PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; return pm->numWriteIO; }
+    if(!pm->fixCounts) pm->fixCounts=malloc(sizeof(int)*pm->capacity);
+    if(pm->fixCounts){ for(int i=0;i<pm->capacity;i++) pm->fixCounts[i]=atomic_load(&pm->frames[i].fixCount); }
+    pthread_mutex_unlock(&pm->mtx); return pm->fixCounts;
+}
+int getNumReadIO (BM_BufferPool *const bm){ PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; return atomic_load(&pm->numReadIO); }
+int getNumWriteIO (BM_BufferPool *const bm){ PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; return atomic_load(&pm->numWriteIO); }
+/** getPoolStats — sum the per-partition hit counters and copy the pool counters; takes no latch. */
+RC getPoolStats (BM_BufferPool *const bm, BM_PoolStats *stats){
+    if(!bm || !bm->mgmtData || !stats){ THROW_AT(RC_FILE_HANDLE_NOT_INIT,"getPoolStats: invalid arguments",NO_PAGE,bm); }
+    PoolMgmt *pm=(PoolMgmt*)bm->mgmtData; PoolCounters *c=&pm->stats; memset(stats,0,sizeof(BM_PoolStats));
+    for(int i=0;i<pm->numParts;i++) stats->hits+=atomic_load_explicit(&pm->parts[i].hits,memory_order_relaxed);
+    stats->misses=atomic_load_explicit(&c->misses,memory_order_relaxed);
+    stats->cleanEvictions=atomic_load_explicit(&c->cleanEvictions,memory_order_relaxed); stats->dirtyEvictions=atomic_load_explicit(&c->dirtyEvictions,memory_order_relaxed);
+    stats->flushes=atomic_load_explicit(&c->flushes,memory_order_relaxed);
+    stats->pinWaitNs=atomic_load_explicit(&c->pinWaitNs,memory_order_relaxed); stats->victimSteps=atomic_load_explicit(&c->victimSteps,memory_order_relaxed);
+    stats->reads=atomic_load(&pm->numReadIO); stats->writes=atomic_load(&pm->numWriteIO);
+    for(int i=0;i<BM_LATENCY_BUCKETS;i++){ stats->readLatency[i]=atomic_load_explicit(&c->readLatency[i],memory_order_relaxed); stats->writeLatency[i]=atomic_load_explicit(&c->writeLatency[i],memory_order_relaxed); }
+    return RC_OK;
+}
@@ -7,13 +7,21 @@
 // Include bool DT
 #include "dt.h"
 
+// SM_WriteMode, IOBackend, LSN
+#include "storage_mgr.h"
+#include "async_io.h"
+#include "wal.h"
+
 // Replacement Strategies
+// RS_LRU_K: stratData may point to an int holding K (default 1, i.e. LRU)
 typedef enum ReplacementStrategy {
 	RS_FIFO = 0,
 	RS_LRU = 1,
 	RS_CLOCK = 2,
 	RS_LFU = 3,
-	RS_LRU_K = 4
+	RS_LRU_K = 4,
+	RS_2Q = 5,
+	RS_ARC = 6
 } ReplacementStrategy;
 
 // Data Types and Structures
@@ -33,6 +41,41 @@ typedef struct BM_PageHandle {
 	char *data;
 } BM_PageHandle;
 
+// Optional pool settings; initPoolOptions fills in the defaults
+typedef struct BM_PoolOptions {
+	bool hugePages;  // back the frames with huge pages (MAP_HUGETLB, else transparent huge pages)
+	int numaNode;    // preferred NUMA node for the frames, -1 for none
+	SM_WriteMode writeMode; // SM_WRITE_SYNC_ON_FLUSH: forcePage/forceFlushPool/shutdown end with one sync
+	int growPages;   // grow the page file by at least this many pages at a time (setGrowthPolicy)
+	int growPercent; // ... and by at least this percentage of its size
+	IOBackend ioBackend; // read-ahead goes through an async I/O engine: io_uring or worker threads (misses read directly)
+	int ioDepth;     // in-flight I/O limit (0 = engine default)
+	int ioWorkers;   // worker threads of the thread backend (0 = engine default)
+	int readAhead;   // pages read ahead of a thread's sequential pin stream (0 = off, at most numPages/2)
+	int bgCleanTarget; // background writer: keep this many of the next victims clean (0 = no writer)
+	int bgMaxRate;   // ... writing at most this many pages per second (0 = unlimited)
+	const char *walFile; // write-ahead log of the page file, replayed at init (NULL = no log)
+	const char *doubleWriteFile; // torn-page protection: pages are written here first, repaired from it at init (NULL = off)
+	                             // every write batch costs two syncs (side file, page file); a miss that evicts a dirty page pays them,
+	                             // so its batch also takes up to 15 more dirty eviction candidates, and bgCleanTarget keeps victims clean
+	const char *traceFile; // record pins, unpins and markDirty to this file for trace_replay (NULL = off)
+} BM_PoolOptions;
+
+// Pool statistics (getPoolStats), counted from initBufferPool on
+#define BM_LATENCY_BUCKETS 32
+typedef struct BM_PoolStats {
+	long long hits;           // pins that found the page in the pool (possibly still being read)
+	long long misses;         // pins that read the page
+	long long cleanEvictions; // victims reused without a write
+	long long dirtyEvictions; // victims written back first
+	long long flushes;        // pages written other than by eviction: forcePage, pool flushes, checkpoints, background writer
+	long long pinWaitNs;      // time pins waited for a contended partition latch (or a full event batch), the pool latch (misses) and reads started by other pins
+	long long victimSteps;    // frames the replacer examined to choose victims
+	long long reads, writes;  // getNumReadIO, getNumWriteIO
+	long long readLatency[BM_LATENCY_BUCKETS];  // miss reads by duration: bucket i counts [2^i, 2^(i+1)) ns, the last one everything longer
+	long long writeLatency[BM_LATENCY_BUCKETS]; // page write calls (a run of pages or a double-write batch each), same buckets
+} BM_PoolStats;
+
 // convenience macros
 #define MAKE_POOL()					\
 		((BM_BufferPool *) malloc (sizeof(BM_BufferPool)))
@@ -44,8 +87,15 @@ typedef struct BM_PageHandle {
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName, 
 		const int numPages, ReplacementStrategy strategy,
 		void *stratData);
+void initPoolOptions (BM_PoolOptions *const opts);
+RC initBufferPoolWithOptions(BM_BufferPool *const bm, const char *const pageFileName,
+		const int numPages, ReplacementStrategy strategy,
+		void *stratData, const BM_PoolOptions *const opts);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
+// fuzzy checkpoint: write the current dirty set while pins continue, then sync and log a checkpoint record;
+// pinned pages are skipped (the log keeps their changes for recovery)
+RC checkpointPool(BM_BufferPool *const bm);
 
 // Buffer Manager Interface Access Pages
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
@@ -53,6 +103,16 @@ RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 		const PageNumber pageNum);
+// start reading pages that are not in the pool yet, without pinning them
+RC prefetchPages (BM_BufferPool *const bm, const PageNumber start, const int count);
+
+// Write-ahead logging (BM_PoolOptions.walFile): log a pinned page's change before unpinning it;
+// until then the pool does not write the page (forcePage aside)
+RC logPageImage (BM_BufferPool *const bm, BM_PageHandle *const page, LSN *lsn);
+RC logPageUpdate (BM_BufferPool *const bm, BM_PageHandle *const page, const int offset,
+		const int length, LSN *lsn);
+// group commit: wait until the log is durable through upTo (LSN_MAX: everything logged so far)
+RC flushLog (BM_BufferPool *const bm, const LSN upTo);
 
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
@@ -60,5 +120,7 @@ bool *getDirtyFlags (BM_BufferPool *const bm);
 int *getFixCounts (BM_BufferPool *const bm);
 int getNumReadIO (BM_BufferPool *const bm);
 int getNumWriteIO (BM_BufferPool *const bm);
+// all counters at once, without taking any latch; concurrent activity may show up in some counters and not yet in others
+RC getPoolStats (BM_BufferPool *const bm, BM_PoolStats *stats);
 
 #endif
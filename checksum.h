@@ -0,0 +1,15 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * CRC-32 (the IEEE polynomial, as in zlib) for recognizing torn or corrupt
+ * on-disk copies: log records (wal.c) and pages in the double-write area
+ * (double_write.c). Start with crc 0; passing the result back in continues
+ * the checksum over the next piece.
+ */
+uint32_t crc32_update (uint32_t crc, const void *data, size_t n);
+
+#endif
@@ -4,7 +4,30 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-char *RC_message;
+_Thread_local char *RC_message;
+static _Thread_local RC_Error lastErr = { RC_OK, NULL, -1, NULL };
+
+void
+setError (RC rc, const char *message, int pageNum, const void *pool)
+{
+	RC_message = (char *) message;
+	lastErr.rc = rc;
+	lastErr.message = message;
+	lastErr.pageNum = pageNum;
+	lastErr.pool = pool;
+}
+
+const RC_Error *
+lastError (void)
+{
+	return &lastErr;
+}
+
+void
+clearError (void)
+{
+	setError(RC_OK, NULL, -1, NULL);
+}
 
 /* print a message to standard out describing the error */
 void 
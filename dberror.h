@@ -27,16 +27,31 @@ typedef int RC;
 #define RC_IM_N_TO_LAGE 302
 #define RC_IM_NO_MORE_ENTRIES 303
 
-/* holder for error messages */
-extern char *RC_message;
+/* holder for error messages: the calling thread's last one, so concurrent failures do not overwrite each other */
+extern _Thread_local char *RC_message;
+
+/* the calling thread's last error, with the page and pool it concerned */
+typedef struct RC_Error {
+	RC rc;
+	const char *message;
+	int pageNum;       /* -1 if the error is not about a page */
+	const void *pool;  /* BM_BufferPool the call was made on, NULL if none */
+} RC_Error;
 
 /* print a message to standard out describing the error */
 extern void printError (RC error);
 extern char *errorMessage (RC error);
 
-#define THROW(rc,message) \
+/* record an error for the calling thread (THROW and THROW_AT do this); lastError never returns NULL */
+extern void setError (RC rc, const char *message, int pageNum, const void *pool);
+extern const RC_Error *lastError (void);
+extern void clearError (void);
+
+#define THROW(rc,message) THROW_AT(rc,message,-1,NULL)
+
+#define THROW_AT(rc,message,page,pool) \
 		do {			  \
-			RC_message=message;	  \
+			setError(rc,message,page,pool);	  \
 			return rc;		  \
 		} while (0)		  \
 
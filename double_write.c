@@ -0,0 +1,182 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "double_write.h"
+#include "checksum.h"
+#include "dberror.h"
+
+/*
+ * Double-Write Area
+ * -----------------
+ * The side file holds at most one batch: a header page, then the batch's
+ * pages in order. The header lists each page's number and the CRC-32 of its
+ * contents and carries a CRC of its own, so recovery can tell an intact
+ * batch (and which of its page copies are intact) from one that was being
+ * written when the process died. An empty or zero-length side file means
+ * there is nothing to recover.
+ *
+ * The batch buffer is the header page followed by DW_MAX_PAGES page copies,
+ * so the side write is a single pwrite, and the home writes are made from
+ * the same copies: the side file and the page file then always receive the
+ * same bytes, even if a caller's page changes right after dw_write copied it.
+ */
+
+/* ------------ Internal structures ------------ */
+
+#define DW_MAGIC 0x31574244u  /* "DBW1" */
+
+typedef struct DwEntry {
+    int32_t  pageNum;
+    uint32_t crc;
+} DwEntry;
+
+typedef struct DwHeader {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t crc;       /* of count and the entries */
+    uint32_t reserved;
+    DwEntry  entries[DW_MAX_PAGES];
+} DwHeader;
+
+_Static_assert(sizeof(DwHeader) <= PAGE_SIZE, "double-write header must fit in a page");
+
+struct DoubleWrite {
+    int             fd;
+    pthread_mutex_t lock;   /* one batch at a time */
+    char           *buf;    /* header page + DW_MAX_PAGES pages */
+};
+
+/* ------------ Helpers ------------ */
+
+static uint32_t header_crc(const DwHeader *h) {
+    uint32_t crc = crc32_update(0, &h->count, sizeof(h->count));
+    return crc32_update(crc, h->entries, sizeof(DwEntry) * h->count);
+}
+
+static int write_all(int fd, const char *p, size_t n, off_t off) {
+    while (n > 0) {
+        ssize_t k = pwrite(fd, p, n, off);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return 0;
+        p += k; n -= (size_t)k; off += k;
+    }
+    return 1;
+}
+
+static int read_all(int fd, char *p, size_t n, off_t off) {
+    while (n > 0) {
+        ssize_t k = pread(fd, p, n, off);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return 0;
+        p += k; n -= (size_t)k; off += k;
+    }
+    return 1;
+}
+
+/* One batch of at most DW_MAX_PAGES pages; caller holds dw->lock */
+static RC write_batch(DoubleWrite *dw, SM_FileHandle *fh, const int *pageNums, SM_PageHandle *pages, int n) {
+    DwHeader *h = (DwHeader *)dw->buf;
+    SM_PageHandle copies[DW_MAX_PAGES];
+
+    memset(h, 0, PAGE_SIZE);
+    h->magic = DW_MAGIC;
+    h->count = (uint32_t)n;
+    for (int i = 0; i < n; i++) {
+        copies[i] = dw->buf + (size_t)(i + 1) * PAGE_SIZE;
+        memcpy(copies[i], pages[i], PAGE_SIZE);
+        h->entries[i].pageNum = pageNums[i];
+        h->entries[i].crc = crc32_update(0, copies[i], PAGE_SIZE);
+    }
+    h->crc = header_crc(h);
+
+    /* the side copy is durable before any home page is touched */
+    if (!write_all(dw->fd, dw->buf, (size_t)(n + 1) * PAGE_SIZE, 0) || fdatasync(dw->fd) != 0) return RC_WRITE_FAILED;
+
+    RC rc = RC_OK;
+    for (int i = 0, j; i < n && rc == RC_OK; i = j) {
+        for (j = i + 1; j < n && pageNums[j] == pageNums[j - 1] + 1; j++);
+        rc = writeBlocks(pageNums[i], j - i, fh, copies + i);
+    }
+    /* ... and the home pages are durable before the side file is overwritten */
+    return (rc == RC_OK) ? syncFile(fh) : rc;
+}
+
+/* ------------ Public API ------------ */
+
+RC dw_open(DoubleWrite **out, const char *fileName) {
+    if (!out || !fileName) return RC_FILE_HANDLE_NOT_INIT;
+    *out = NULL;
+
+    DoubleWrite *dw = calloc(1, sizeof(DoubleWrite));
+    if (!dw) return RC_WRITE_FAILED;
+    dw->buf = aligned_alloc(PAGE_SIZE, (size_t)(DW_MAX_PAGES + 1) * PAGE_SIZE);
+    dw->fd = open(fileName, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (!dw->buf || dw->fd < 0) {
+        RC rc = (dw->fd < 0) ? RC_FILE_NOT_FOUND : RC_WRITE_FAILED;
+        if (dw->fd >= 0) close(dw->fd);
+        free(dw->buf);
+        free(dw);
+        return rc;
+    }
+    pthread_mutex_init(&dw->lock, NULL);
+    *out = dw;
+    return RC_OK;
+}
+
+void dw_close(DoubleWrite *dw) {
+    if (!dw) return;
+    close(dw->fd);
+    pthread_mutex_destroy(&dw->lock);
+    free(dw->buf);
+    free(dw);
+}
+
+RC dw_write(DoubleWrite *dw, SM_FileHandle *fh, const int *pageNums, SM_PageHandle *pages, int n) {
+    if (!dw || !fh || n < 0 || (n > 0 && (!pageNums || !pages))) return RC_FILE_HANDLE_NOT_INIT;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&dw->lock);
+    for (int i = 0; i < n && rc == RC_OK; i += DW_MAX_PAGES)
+        rc = write_batch(dw, fh, pageNums + i, pages + i, (n - i < DW_MAX_PAGES) ? n - i : DW_MAX_PAGES);
+    pthread_mutex_unlock(&dw->lock);
+    return rc;
+}
+
+RC dw_recover(DoubleWrite *dw, SM_FileHandle *fh, int *repaired) {
+    if (!dw || !fh) return RC_FILE_HANDLE_NOT_INIT;
+    DwHeader *h = (DwHeader *)dw->buf;
+    char *copy = dw->buf + PAGE_SIZE, *home = dw->buf + 2 * PAGE_SIZE;
+    int fixed = 0;
+    RC rc = RC_OK;
+
+    pthread_mutex_lock(&dw->lock);
+    /* a missing, short or torn header: the crash hit the side write, and no home page was written */
+    if (read_all(dw->fd, (char *)h, PAGE_SIZE, 0) && h->magic == DW_MAGIC && h->count <= DW_MAX_PAGES && header_crc(h) == h->crc) {
+        DwHeader batch = *h;
+        for (uint32_t i = 0; i < batch.count && rc == RC_OK; i++) {
+            int p = batch.entries[i].pageNum;
+            if (p < 0 || !read_all(dw->fd, copy, PAGE_SIZE, (off_t)(i + 1) * PAGE_SIZE) || crc32_update(0, copy, PAGE_SIZE) != batch.entries[i].crc)
+                continue;   /* side copy torn: its home write never started */
+            rc = ensureCapacity(p + 1, fh);
+            if (rc == RC_OK && readBlock(p, fh, home) == RC_OK && memcmp(home, copy, PAGE_SIZE) == 0) continue;
+            if (rc == RC_OK) rc = writeBlock(p, fh, copy);
+            if (rc == RC_OK) fixed++;
+        }
+        if (rc == RC_OK && fixed > 0) rc = syncFile(fh);
+    }
+    pthread_mutex_unlock(&dw->lock);
+    if (repaired) *repaired = fixed;
+    return (rc == RC_OK) ? dw_reset(dw) : rc;
+}
+
+RC dw_reset(DoubleWrite *dw) {
+    if (!dw) return RC_FILE_HANDLE_NOT_INIT;
+    pthread_mutex_lock(&dw->lock);
+    int ok = ftruncate(dw->fd, 0) == 0 && fdatasync(dw->fd) == 0;
+    pthread_mutex_unlock(&dw->lock);
+    return ok ? RC_OK : RC_WRITE_FAILED;
+}
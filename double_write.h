@@ -0,0 +1,40 @@
+#ifndef DOUBLE_WRITE_H
+#define DOUBLE_WRITE_H
+
+#include "storage_mgr.h"
+
+/*
+ * DoubleWrite — torn-page protection for a page file through a side file.
+ * ------------------------------------------------------------
+ * A batch of pages is copied into a buffer, written to the side file with
+ * one sequential write and synced, and only then written to its home
+ * locations in the page file, which is synced in turn before the next batch
+ * may reuse the side file. A crash during the home writes can therefore
+ * tear a page only while an intact copy of it sits in the side file, and
+ * dw_recover puts that copy back at startup. A crash while the side file is
+ * being written leaves every home page untouched.
+ *
+ * Batches are serialized; pages written from several threads go through the
+ * side file one batch at a time.
+ */
+
+#define DW_MAX_PAGES 64   /* pages per batch; larger writes are split */
+
+typedef struct DoubleWrite DoubleWrite;
+
+RC   dw_open (DoubleWrite **dw, const char *fileName);
+void dw_close (DoubleWrite *dw);
+
+/*
+ * Write pages[i] to page pageNums[i] of fh, i < n, through the side file;
+ * consecutive page numbers go home as one vectored write. The pages must
+ * exist in the file (ensureCapacity) and must not change during the call.
+ */
+RC   dw_write (DoubleWrite *dw, SM_FileHandle *fh, const int *pageNums, SM_PageHandle *pages, int n);
+
+/* startup: rewrite the pages of the last batch whose home copy differs from their intact side copy, then empty the side file */
+RC   dw_recover (DoubleWrite *dw, SM_FileHandle *fh, int *repaired);
+/* empty the side file, once every page written through it is durable at home */
+RC   dw_reset (DoubleWrite *dw);
+
+#endif
@@ -0,0 +1,62 @@
+#define _GNU_SOURCE
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "frame_arena.h"
+#include "storage_mgr.h"
+
+/* ------------ Placement ------------ */
+
+#define ARENA_HUGE_PAGE   (2u * 1024 * 1024)
+#define ARENA_MPOL_PREFERRED 1   /* <numaif.h> MPOL_PREFERRED, without depending on libnuma */
+
+static size_t round_up(size_t n, size_t unit) {
+    return (n + unit - 1) / unit * unit;
+}
+
+/* Prefer numaNode for the whole mapping; best effort, called before any page is touched */
+static void arena_bind(FrameArena *a, int numaNode) {
+#ifdef SYS_mbind
+    unsigned long mask[16] = {0};
+    if (numaNode < 0 || numaNode >= (int)(sizeof(mask) * 8)) return;
+    mask[numaNode / (sizeof(unsigned long) * 8)] = 1UL << (numaNode % (sizeof(unsigned long) * 8));
+    (void)syscall(SYS_mbind, a->base, a->size, ARENA_MPOL_PREFERRED, mask, sizeof(mask) * 8, 0);
+#else
+    (void)a; (void)numaNode;
+#endif
+}
+
+/* ------------ Lifecycle ------------ */
+
+RC arena_init(FrameArena *a, int numFrames, bool hugePages, int numaNode) {
+    size_t bytes = (size_t)numFrames * PAGE_SIZE;
+    memset(a, 0, sizeof(FrameArena));
+    if (numFrames <= 0) return RC_FILE_HANDLE_NOT_INIT;
+
+#ifdef MAP_HUGETLB
+    if (hugePages) {
+        a->size = round_up(bytes, ARENA_HUGE_PAGE);
+        a->base = mmap(NULL, a->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (a->base != MAP_FAILED) a->hugetlb = TRUE;
+    }
+#endif
+    if (!a->hugetlb) {
+        a->size = round_up(bytes, (size_t)sysconf(_SC_PAGESIZE));
+        a->base = mmap(NULL, a->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (a->base == MAP_FAILED) {
+            memset(a, 0, sizeof(FrameArena));
+            return RC_WRITE_FAILED;
+        }
+#ifdef MADV_HUGEPAGE
+        if (hugePages) (void)madvise(a->base, a->size, MADV_HUGEPAGE);   /* no hugetlbfs pool: ask for THP */
+#endif
+    }
+    arena_bind(a, numaNode);
+    return RC_OK;
+}
+
+void arena_free(FrameArena *a) {
+    if (a->base) munmap(a->base, a->size);
+    memset(a, 0, sizeof(FrameArena));
+}
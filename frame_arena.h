@@ -0,0 +1,28 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <stddef.h>
+#include "dberror.h"
+#include "dt.h"
+
+/*
+ * FrameArena — one contiguous, page-aligned block holding the data of every
+ * frame of a pool, frame i at base + i*PAGE_SIZE.
+ * ------------------------------------------------------------
+ * The block is an anonymous mapping, so it is zero-filled and only backed by
+ * memory as frames are first touched; a large pool starts with one system
+ * call. With hugePages the mapping is tried with MAP_HUGETLB first and falls
+ * back to ordinary pages marked for transparent huge pages. numaNode >= 0
+ * asks the kernel to place the block on that node; it is a preference, and a
+ * kernel without NUMA support simply ignores it.
+ */
+typedef struct FrameArena {
+    char   *base;
+    size_t  size;      /* mapped length, a multiple of the (huge) page size */
+    bool    hugetlb;   /* backed by MAP_HUGETLB pages */
+} FrameArena;
+
+RC   arena_init (FrameArena *a, int numFrames, bool hugePages, int numaNode);
+void arena_free (FrameArena *a);
+
+#endif
@@ -0,0 +1,23 @@
+#include "page_table.h"
+
+#include <stdlib.h>
+
+/* ==============================
+ * PageTable helpers (open addressing)
+ * ============================== */
+unsigned hash_page(PageNumber p){ unsigned x=(unsigned)p; x^=x>>16; x*=0x7feb352dU; x^=x>>15; x*=0x846ca68bU; x^=x>>16; return x;}
+/** Initialize the page table sized to ~3x the expected number of entries. */
+RC ptab_init(PageTable *t,int approx){int cap=8; while(cap<approx*3) cap<<=1; t->slots=malloc(sizeof(PageSlot)*cap); if(!t->slots) return RC_WRITE_FAILED; for(int i=0;i<cap;i++) t->slots[i].key=NO_PAGE; t->cap=cap; t->count=0; return RC_OK;}
+void ptab_free(PageTable *t){ free(t->slots); t->slots=NULL; t->cap=t->count=0; }
+/** Slot holding key, or the empty slot that ends its probe run (the load factor stays below 1/2, so there always is one). */
+static int ptab_find_slot(const PageTable *t, PageNumber key){ int mask=t->cap-1, idx=(int)(hash_page(key)&mask); while(t->slots[idx].key!=key && t->slots[idx].key!=NO_PAGE) idx=(idx+1)&mask; return idx; }
+/** Double the table and reinsert live entries; partitions start small, so a skewed one can outgrow its slice. */
+static RC ptab_grow(PageTable *t){ PageTable old=*t; if(ptab_init(t,old.cap)!=RC_OK){ *t=old; return RC_WRITE_FAILED; } for(int i=0;i<old.cap;i++){ if(old.slots[i].key!=NO_PAGE) ptab_put(t,old.slots[i].key,old.slots[i].val); } ptab_free(&old); return RC_OK; }
+RC ptab_put(PageTable *t, PageNumber key, int val){ if(key<0) return RC_READ_NON_EXISTING_PAGE; int slot=ptab_find_slot(t,key); if(t->slots[slot].key==key){ t->slots[slot].val=val; return RC_OK; } if((t->count+1)*2>t->cap){ if(ptab_grow(t)!=RC_OK) return RC_WRITE_FAILED; slot=ptab_find_slot(t,key); } t->slots[slot].key=key; t->slots[slot].val=val; t->count++; return RC_OK; }
+int ptab_get(PageTable *t, PageNumber key){ if(key<0) return -1; int slot=ptab_find_slot(t,key); return (t->slots[slot].key==key)?t->slots[slot].val:-1; }
+/** Backward-shift deletion: pull later entries of the probe run into the hole unless that would move them before their home slot. */
+void ptab_del(PageTable *t, PageNumber key){
+    if(key<0){ return; } int mask=t->cap-1, hole=ptab_find_slot(t,key); if(t->slots[hole].key!=key) return;
+    for(int j=(hole+1)&mask; t->slots[j].key!=NO_PAGE; j=(j+1)&mask){ int home=(int)(hash_page(t->slots[j].key)&mask); if(((j-home)&mask)>=((j-hole)&mask)){ t->slots[hole]=t->slots[j]; hole=j; } }
+    t->slots[hole].key=NO_PAGE; t->count--;
+}
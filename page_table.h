@@ -0,0 +1,34 @@
+#ifndef PAGE_TABLE_H
+#define PAGE_TABLE_H
+
+#include "buffer_mgr.h"
+
+/**
+ * PageTable — an intentionally tiny, dependency-free hash map used to
+ * quickly find which frame currently holds a given page number.
+ * Linear probing over one slot array; key and value share a slot and
+ * key == NO_PAGE marks it empty, so keys must be >= 0. Deletion shifts the
+ * rest of the probe run back instead of leaving tombstones, so a lookup never
+ * walks further than the live entries of its run, however long the pool runs.
+ * Shared by the buffer manager (page -> frame) and the replacer (page -> ghost).
+ * Not thread-safe; callers hold the latch that owns the table.
+ */
+typedef struct PageSlot {
+    PageNumber key;
+    int        val;
+} PageSlot;
+
+typedef struct PageTable {
+    PageSlot   *slots;
+    int         cap;      /* power of two */
+    int         count;
+} PageTable;
+
+unsigned hash_page (PageNumber p);
+RC   ptab_init (PageTable *t, int approx);
+void ptab_free (PageTable *t);
+RC   ptab_put (PageTable *t, PageNumber key, int val);
+int  ptab_get (PageTable *t, PageNumber key);   /* -1 if absent */
+void ptab_del (PageTable *t, PageNumber key);
+
+#endif
@@ -0,0 +1,158 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "probe.h"
+#include "dberror.h"
+
+#if defined(BM_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define PROBE_USDT(phase, page, dur) DTRACE_PROBE3(bufmgr, span, phase, page, dur)
+#endif
+#endif
+#ifndef PROBE_USDT
+#define PROBE_USDT(phase, page, dur) ((void)0)
+#endif
+
+/*
+ * Span Rings
+ * ----------
+ * A thread claims a ring on its first span and keeps it for its lifetime;
+ * rings are never freed, so a dump still sees the spans of threads that
+ * have exited. At most PROBE_MAX_THREADS threads get a ring; later ones do
+ * not record. A ring is written only by its thread: the span goes into the
+ * slot of index head, then head is published. A dump copies the last
+ * PROBE_RING_SPANS indices below head and afterwards drops those the
+ * writer may have overwritten meanwhile (indices that fell out of the
+ * window, or were about to, by the time the copy finished). Slot words
+ * are relaxed atomics, which compile to plain loads and stores.
+ */
+
+/* ------------ Internal structures ------------ */
+
+#define PROBE_RING_SPANS  16384
+#define PROBE_MAX_THREADS 256
+
+typedef struct ProbeSlot {
+    atomic_llong start;
+    atomic_llong dur;
+    atomic_llong pagePhase;   /* page << 8 | phase */
+} ProbeSlot;
+
+typedef struct ProbeRing {
+    atomic_llong head;        /* spans recorded so far */
+    ProbeSlot    slots[PROBE_RING_SPANS];
+} ProbeRing;
+
+typedef struct ProbeSpan {
+    long long  start, dur;
+    PageNumber page;
+    int        phase, tid;
+} ProbeSpan;
+
+static const char *phaseNames[PROBE_PHASES] = { "pin", "pool latch", "victim search", "evict write", "read", "load wait" };
+
+static ProbeRing *_Atomic rings[PROBE_MAX_THREADS];
+static atomic_int numRings;
+static _Thread_local ProbeRing *myRing;
+static _Thread_local bool noRing;
+
+/* ------------ Helpers ------------ */
+
+static ProbeRing *claim_ring(void) {
+    if (noRing) return NULL;
+    int i = atomic_fetch_add(&numRings, 1);
+    ProbeRing *r = (i < PROBE_MAX_THREADS) ? calloc(1, sizeof(ProbeRing)) : NULL;
+    if (!r) {
+        noRing = TRUE;
+        return NULL;
+    }
+    atomic_store(&rings[i], r);
+    return myRing = r;
+}
+
+static int cmp_start(const void *a, const void *b) {
+    long long x = ((const ProbeSpan *)a)->start, y = ((const ProbeSpan *)b)->start;
+    return (x > y) - (x < y);
+}
+
+/* ------------ Public API ------------ */
+
+long long probe_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+void probe_span(ProbePhase phase, PageNumber page, long long start) {
+    long long dur = probe_now() - start;
+    PROBE_USDT((int)phase, (int)page, dur);
+    ProbeRing *r = myRing ? myRing : claim_ring();
+    if (!r) return;
+    long long h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    ProbeSlot *s = &r->slots[h % PROBE_RING_SPANS];
+    atomic_store_explicit(&s->start, start, memory_order_relaxed);
+    atomic_store_explicit(&s->dur, dur, memory_order_relaxed);
+    atomic_store_explicit(&s->pagePhase, ((long long)page << 8) | phase, memory_order_relaxed);
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+}
+
+RC probe_dumpChromeTrace(const char *fileName) {
+    if (!fileName) return RC_FILE_HANDLE_NOT_INIT;
+    int n = atomic_load(&numRings);
+    if (n > PROBE_MAX_THREADS) n = PROBE_MAX_THREADS;
+    ProbeSpan *spans = malloc(sizeof(ProbeSpan) * PROBE_RING_SPANS * (size_t)(n > 0 ? n : 1));
+    if (!spans) return RC_WRITE_FAILED;
+    long count = 0;
+
+    for (int t = 0; t < n; t++) {
+        ProbeRing *r = atomic_load(&rings[t]);
+        if (!r) continue;   /* claimed, not yet published */
+        long long head = atomic_load_explicit(&r->head, memory_order_acquire);
+        long long from = (head > PROBE_RING_SPANS) ? head - PROBE_RING_SPANS : 0;
+        long first = count;
+        for (long long i = from; i < head; i++) {
+            ProbeSlot *s = &r->slots[i % PROBE_RING_SPANS];
+            long long pp = atomic_load_explicit(&s->pagePhase, memory_order_relaxed);
+            spans[count].start = atomic_load_explicit(&s->start, memory_order_relaxed);
+            spans[count].dur = atomic_load_explicit(&s->dur, memory_order_relaxed);
+            spans[count].page = (PageNumber)(pp >> 8);
+            spans[count].phase = (int)(pp & 0xff);
+            spans[count].tid = t + 1;
+            count++;
+        }
+        /* the writer may have lapped the oldest copied slots meanwhile */
+        atomic_thread_fence(memory_order_acquire);
+        long long now = atomic_load_explicit(&r->head, memory_order_relaxed);
+        long long lapped = now + 1 - PROBE_RING_SPANS - from;   /* index now is being written, over now - PROBE_RING_SPANS */
+        if (lapped > 0) {
+            long keep = count - first - (long)((lapped < head - from) ? lapped : head - from);
+            for (long i = 0; i < keep; i++) spans[first + i] = spans[count - keep + i];
+            count = first + keep;
+        }
+    }
+    qsort(spans, (size_t)count, sizeof(ProbeSpan), cmp_start);
+
+    FILE *out = fopen(fileName, "w");
+    if (!out) {
+        free(spans);
+        return RC_FILE_NOT_FOUND;
+    }
+    long long base = count ? spans[0].start : 0;
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    for (long i = 0; i < count; i++) {
+        const ProbeSpan *s = &spans[i];
+        fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"bufmgr\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"page\":%d}}",
+                i ? "," : "", (s->phase < PROBE_PHASES) ? phaseNames[s->phase] : "?", (s->start - base) / 1000.0, s->dur / 1000.0,
+                (int)getpid(), s->tid, s->page);
+    }
+    fprintf(out, "\n]}\n");
+    int bad = ferror(out);
+    if (fclose(out) != 0) bad = 1;
+    free(spans);
+    return bad ? RC_WRITE_FAILED : RC_OK;
+}
@@ -0,0 +1,46 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include "buffer_mgr.h"
+
+/*
+ * Probe — timing spans around the phases of a pin, for diagnosing latency.
+ * ------------------------------------------------------------
+ * Built only with -DBM_PROBES (make PROBES=1). Each instrumented phase
+ * records a span (phase, page, start, duration) in a ring buffer of the
+ * calling thread, overwriting its oldest spans when full, and fires the
+ * USDT probe bufmgr:span(phase, page, durationNs) when <sys/sdt.h> is
+ * available, for perf, bpftrace or SystemTap. probe_dumpChromeTrace writes
+ * the spans still in the rings as Chrome trace JSON (chrome://tracing,
+ * Perfetto); it may run while other threads keep recording.
+ *
+ * Without BM_PROBES the PROBE_ macros expand to nothing, so the
+ * instrumented code is what it would be without them, and the dump writes
+ * an empty trace.
+ */
+
+typedef enum ProbePhase {
+    PROBE_PIN = 0,        /* a whole pinPage */
+    PROBE_POOL_LATCH,     /* a miss waiting for the pool latch (contended only) */
+    PROBE_VICTIM,         /* choosing and detaching a victim */
+    PROBE_EVICT_WRITE,    /* writing a victim back if it is dirty */
+    PROBE_READ,           /* reading a missed page into its frame */
+    PROBE_LOAD_WAIT,      /* a pin waiting for another pin's read */
+    PROBE_PHASES
+} ProbePhase;
+
+#ifdef BM_PROBES
+#define PROBE_START(var)             long long var = probe_now()
+#define PROBE_END(var, phase, page)  probe_span((phase), (page), var)
+#else
+#define PROBE_START(var)             ((void)0)
+#define PROBE_END(var, phase, page)  ((void)(page))
+#endif
+
+long long probe_now (void);
+void probe_span (ProbePhase phase, PageNumber page, long long start);
+
+/* write every thread's recorded spans to fileName as Chrome trace JSON */
+RC   probe_dumpChromeTrace (const char *fileName);
+
+#endif
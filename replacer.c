@@ -0,0 +1,654 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "replacer.h"
+
+/*
+ * Replacement Policies
+ * --------------------
+ * FIFO  — queue in load order. Hits do not move a frame. A pinned frame
+ *         stays queued until it reaches the head; victim selection then
+ *         parks it off the queue, and releasing it puts it back at the front,
+ *         behind the parked frames released before it. Each park is paid for
+ *         by a pin, so selection is amortized O(1).
+ * LRU   — queue of evictable frames in release order. A hit unlinks the
+ *         frame (pinned frames are never queued) and the release appends it.
+ * CLOCK — second chance over all frames with a reference bit.
+ * LRU-K — O'Neil et al.: evict the page whose K-th most recent reference
+ *         is oldest; pages with fewer than K references go first, oldest
+ *         last reference first. Histories of evicted pages are retained
+ *         (up to one per frame) and restored when the page comes back.
+ * LFU   — LFU with dynamic aging (LFU-DA): a reference sets a frame's
+ *         priority to its reference count plus the priority of the last
+ *         victim, so popularity earned long ago loses out to pages that are
+ *         referenced now. Ties go to the least recently referenced frame.
+ * 2Q    — Johnson & Shasha (full version): first-time pages enter the FIFO
+ *         A1in; when A1in holds more than a quarter of the frames it gives up
+ *         its oldest page, which is remembered in the ghost queue A1out (half
+ *         as many entries as frames). A page that misses while remembered in
+ *         A1out goes to the LRU queue Am, which is otherwise the victim source.
+ *         A scan only ever cycles through A1in.
+ * ARC   — Megiddo & Modha: T1 holds pages seen once recently, T2 pages seen
+ *         at least twice; their evicted pages are remembered in the ghost
+ *         lists B1 and B2 (together at most one entry per frame). A miss on a
+ *         B1 ghost grows the target size p of T1, one on a B2 ghost shrinks
+ *         it, and the victim comes from T1 while T1 is above p.
+ *
+ * Read-ahead: a prefetched page is placed like a load but records no
+ * reference; its first access is treated as the load (2Q and ARC look for
+ * its ghost only then). If that access is all it gets, the release puts it
+ * at the eviction end of its queue (CLOCK: no reference bit; LRU-K and LFU:
+ * ahead of every other frame in the heap), ordered by release.
+ *
+ * A queue is thus made of three runs: cold frames, then parked frames that
+ * rejoined, then everything else. Each run is ordered by the time its frames
+ * were put there, so the list remembers where the first two end and both
+ * kinds of release are an insertion behind that point.
+ */
+
+/* ------------ List helpers ------------ */
+
+static void list_unlink(Replacer *r, int f) {
+    ReplFrame *n = &r->frames[f];
+    if (!n->linked) return;
+    ReplList *l = &r->lists[n->list];
+    if (n->prev >= 0) r->frames[n->prev].next = n->next; else l->head = n->next;
+    if (n->next >= 0) r->frames[n->next].prev = n->prev; else l->tail = n->prev;
+    if (l->coldTail == f) l->coldTail = n->prev;   /* the cold run starts at the head */
+    if (l->parkTail == f) l->parkTail = (n->prev >= 0 && r->frames[n->prev].run == REPL_REJOINED) ? n->prev : -1;
+    n->prev = n->next = -1;
+    n->linked = FALSE;
+}
+
+/* Link f into its list in front of `before` (-1 = at the tail) */
+static void list_insert_before(Replacer *r, int f, int before) {
+    ReplFrame *n = &r->frames[f];
+    ReplList *l = &r->lists[n->list];
+    n->next = before;
+    n->prev = (before >= 0) ? r->frames[before].prev : l->tail;
+    if (n->prev >= 0) r->frames[n->prev].next = f; else l->head = f;
+    if (before >= 0) r->frames[before].prev = f; else l->tail = f;
+    n->linked = TRUE;
+}
+
+/* Link f behind `after` (-1 = at the head) */
+static void list_insert_after(Replacer *r, int f, int after) {
+    list_insert_before(r, f, (after >= 0) ? r->frames[after].next : r->lists[r->frames[f].list].head);
+}
+
+static void list_push_tail(Replacer *r, int f) {
+    r->frames[f].run = REPL_QUEUED;
+    list_insert_before(r, f, -1);
+}
+
+/* Move a resident frame to another list (unlinked; the caller links it when due) */
+static void list_move(Replacer *r, int f, int list) {
+    list_unlink(r, f);
+    r->listSize[r->frames[f].list]--;
+    r->listSize[list]++;
+    r->frames[f].list = list;
+}
+
+/* FIFO order: take pinned frames off the head of list; each one is put back when released */
+static int fifo_head(Replacer *r, int list) {
+    ReplList *l = &r->lists[list];
+    while (l->head >= 0 && !r->frames[l->head].evictable) {
+        list_unlink(r, l->head);   /* park */
+        r->steps++;
+    }
+    return l->head;
+}
+
+/* FIFO order: a released frame that was parked goes back to the front, behind the cold frames and earlier rejoiners */
+static void fifo_rejoin(Replacer *r, int f) {
+    ReplFrame *n = &r->frames[f];
+    if (n->linked) return;
+    ReplList *l = &r->lists[n->list];
+    n->run = REPL_REJOINED;
+    list_insert_after(r, f, (l->parkTail >= 0) ? l->parkTail : l->coldTail);
+    l->parkTail = f;
+}
+
+/* Read-ahead: queue a page released after its only access in front of every other frame, behind older cold frames */
+static void cold_release(Replacer *r, int f) {
+    list_unlink(r, f);
+    ReplList *l = &r->lists[r->frames[f].list];
+    r->frames[f].run = REPL_COLD;
+    list_insert_after(r, f, l->coldTail);
+    l->coldTail = f;
+}
+
+/* FIFO order: a frame counts as loaded now */
+static void fifo_requeue(Replacer *r, int f) {
+    list_unlink(r, f);
+    list_push_tail(r, f);
+}
+
+/* An event is stale if the frame has been emptied or reloaded since it was recorded */
+static int stale(Replacer *r, int f, PageNumber page, long long tick) {
+    return r->frames[f].page != page || tick < r->frames[f].loadTick;
+}
+
+/* LRU order: a released frame goes to the MRU end */
+static void lru_release(Replacer *r, int f) {
+    list_unlink(r, f);
+    list_push_tail(r, f);
+}
+
+/* ------------ LRU-K history, LFU priority and victim heap ------------ */
+
+static long long *hist(Replacer *r, int f) {
+    return &r->hist[(size_t)f * r->k];
+}
+
+/* Record a reference: shift the history and put tick in front */
+static void hist_push(long long *h, int *nrefs, int k, long long tick) {
+    memmove(h + 1, h, sizeof(long long) * (k - 1));
+    h[0] = tick;
+    if (*nrefs < k) (*nrefs)++;
+}
+
+/* Should frame a be evicted before frame b? */
+static int lruk_before(Replacer *r, int a, int b) {
+    long long *ha = hist(r, a), *hb = hist(r, b);
+    long long ka = (r->frames[a].nrefs >= r->k) ? ha[r->k - 1] : LLONG_MIN;
+    long long kb = (r->frames[b].nrefs >= r->k) ? hb[r->k - 1] : LLONG_MIN;
+    if (ka != kb) return ka < kb;
+    return ha[0] < hb[0];
+}
+
+static int lfu_before(Replacer *r, int a, int b) {
+    if (r->frames[a].prio != r->frames[b].prio) return r->frames[a].prio < r->frames[b].prio;
+    return r->frames[a].stamp < r->frames[b].stamp;
+}
+
+static int before(Replacer *r, int a, int b) {
+    if (r->frames[a].cold != r->frames[b].cold) return r->frames[a].cold;
+    return (r->strategy == RS_LFU) ? lfu_before(r, a, b) : lruk_before(r, a, b);
+}
+
+/* LFU: count a reference and re-age the priority */
+static void lfu_reference(Replacer *r, int f, long long tick) {
+    ReplFrame *n = &r->frames[f];
+    n->nrefs++;
+    n->prio = n->nrefs + r->age;
+    n->stamp = tick;
+}
+
+static void heap_set(Replacer *r, int pos, int f) {
+    r->heap[pos] = f;
+    r->frames[f].heapPos = pos;
+}
+
+static void heap_sift_up(Replacer *r, int pos) {
+    int f = r->heap[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!before(r, f, r->heap[parent])) break;
+        heap_set(r, pos, r->heap[parent]);
+        pos = parent;
+    }
+    heap_set(r, pos, f);
+}
+
+static void heap_sift_down(Replacer *r, int pos) {
+    int f = r->heap[pos];
+    for (;;) {
+        int child = 2 * pos + 1;
+        if (child >= r->heapSize) break;
+        if (child + 1 < r->heapSize && before(r, r->heap[child + 1], r->heap[child])) child++;
+        if (!before(r, r->heap[child], f)) break;
+        heap_set(r, pos, r->heap[child]);
+        pos = child;
+    }
+    heap_set(r, pos, f);
+}
+
+static void heap_insert(Replacer *r, int f) {
+    if (r->frames[f].heapPos >= 0) return;
+    heap_set(r, r->heapSize++, f);
+    heap_sift_up(r, r->heapSize - 1);
+}
+
+static void heap_remove(Replacer *r, int f) {
+    int pos = r->frames[f].heapPos;
+    if (pos < 0) return;
+    r->frames[f].heapPos = -1;
+    int last = r->heap[--r->heapSize];
+    if (pos == r->heapSize) return;
+    heap_set(r, pos, last);
+    heap_sift_down(r, pos);
+    heap_sift_up(r, r->frames[last].heapPos);
+}
+
+/* ------------ Ghosts ------------ */
+
+static void ghost_unlink(Replacer *r, int g) {
+    ReplGhost *n = &r->ghosts[g];
+    ReplList *l = &r->ghostLists[n->list];
+    if (n->prev >= 0) r->ghosts[n->prev].next = n->next; else l->head = n->next;
+    if (n->next >= 0) r->ghosts[n->next].prev = n->prev; else l->tail = n->prev;
+    n->prev = n->next = -1;
+    r->ghostSize[n->list]--;
+}
+
+static void ghost_drop(Replacer *r, int g) {
+    ghost_unlink(r, g);
+    ptab_del(&r->ghostMap, r->ghosts[g].page);
+    r->ghosts[g].page = NO_PAGE;
+    r->freeGhosts[r->numFreeGhosts++] = g;
+}
+
+/*
+ * Remember an evicted frame's page at the tail of ghost list `list`. When all
+ * ghosts are in use the oldest one goes, taken from list 1 first (ARC drops
+ * from B2 when the directory is full).
+ */
+static void ghost_retain(Replacer *r, int f, int list) {
+    if (r->numFreeGhosts == 0) ghost_drop(r, r->ghostLists[r->ghostSize[1] > 0 ? 1 : 0].head);
+    int g = r->freeGhosts[--r->numFreeGhosts];
+    if (ptab_put(&r->ghostMap, r->frames[f].page, g) != RC_OK) {
+        r->freeGhosts[r->numFreeGhosts++] = g;
+        return;
+    }
+    ReplGhost *n = &r->ghosts[g];
+    ReplList *l = &r->ghostLists[list];
+    n->page = r->frames[f].page;
+    n->list = list;
+    if (r->ghostHist) {
+        n->nrefs = r->frames[f].nrefs;
+        memcpy(&r->ghostHist[(size_t)g * r->k], hist(r, f), sizeof(long long) * r->k);
+    }
+    n->next = -1;
+    n->prev = l->tail;
+    if (n->prev >= 0) r->ghosts[n->prev].next = g; else l->head = g;
+    l->tail = g;
+    r->ghostSize[list]++;
+}
+
+/* LRU-K: restore the retained history of page into frame f, if there is one */
+static void ghost_restore(Replacer *r, int f, PageNumber page) {
+    int g = ptab_get(&r->ghostMap, page);
+    if (g < 0) return;
+    r->frames[f].nrefs = r->ghosts[g].nrefs;
+    memcpy(hist(r, f), &r->ghostHist[(size_t)g * r->k], sizeof(long long) * r->k);
+    ghost_drop(r, g);
+}
+
+/* ------------ ARC ------------ */
+
+/* T1 target size after a miss on ghost g (-1: not a ghost) */
+static int arc_target(Replacer *r, int g) {
+    if (g < 0) return r->p;
+    int b1 = r->ghostSize[ARC_B1], b2 = r->ghostSize[ARC_B2];
+    if (r->ghosts[g].list == ARC_B1) {
+        int delta = (b2 > b1) ? b2 / b1 : 1;
+        return (r->p + delta < r->capacity) ? r->p + delta : r->capacity;
+    }
+    int delta = (b1 > b2) ? b1 / b2 : 1;
+    return (r->p - delta > 0) ? r->p - delta : 0;
+}
+
+static int victim_arc(Replacer *r, PageNumber page) {
+    int g = ptab_get(&r->ghostMap, page);
+    int p = arc_target(r, g);
+    int t1 = r->listSize[ARC_T1];
+    int fromT1 = t1 >= 1 && (t1 > p || (g >= 0 && r->ghosts[g].list == ARC_B2 && t1 == p));
+    int v = r->lists[fromT1 ? ARC_T1 : ARC_T2].head;
+    return (v >= 0) ? v : r->lists[fromT1 ? ARC_T2 : ARC_T1].head;   /* the preferred list may be all pinned */
+}
+
+/* A page was loaded into f: adapt p on a ghost hit, otherwise bound the B1 directory */
+static void arc_load(Replacer *r, int f, PageNumber page) {
+    int g = ptab_get(&r->ghostMap, page);
+    if (g >= 0) {
+        r->p = arc_target(r, g);
+        ghost_drop(r, g);
+        list_move(r, f, ARC_T2);
+        return;
+    }
+    while (r->listSize[ARC_T1] + r->ghostSize[ARC_B1] > r->capacity && r->ghostSize[ARC_B1] > 0)
+        ghost_drop(r, r->ghostLists[ARC_B1].head);
+}
+
+/* ------------ Lifecycle ------------ */
+
+static RC ghosts_init(Replacer *r, int cap, int withHist) {
+    r->ghostCap = (cap > 0) ? cap : 1;
+    r->ghosts = malloc(sizeof(ReplGhost) * r->ghostCap);
+    r->freeGhosts = malloc(sizeof(int) * r->ghostCap);
+    if (withHist) r->ghostHist = malloc(sizeof(long long) * r->ghostCap * r->k);
+    if (!r->ghosts || !r->freeGhosts || (withHist && !r->ghostHist)) return RC_WRITE_FAILED;
+    if (ptab_init(&r->ghostMap, r->ghostCap) != RC_OK) return RC_WRITE_FAILED;
+    for (int g = r->ghostCap - 1; g >= 0; g--) {
+        r->ghosts[g].page = NO_PAGE;
+        r->ghosts[g].prev = r->ghosts[g].next = -1;
+        r->freeGhosts[r->numFreeGhosts++] = g;
+    }
+    return RC_OK;
+}
+
+static RC lruk_init(Replacer *r) {
+    r->hist = calloc((size_t)r->capacity * r->k, sizeof(long long));
+    r->heap = malloc(sizeof(int) * r->capacity);
+    if (!r->hist || !r->heap) return RC_WRITE_FAILED;
+    if (r->k == 1) return RC_OK;   /* one reference of history needs no retention */
+    return ghosts_init(r, r->capacity, TRUE);
+}
+
+static RC strategy_init(Replacer *r) {
+    switch (r->strategy) {
+    case RS_LRU_K:
+        return lruk_init(r);
+    case RS_LFU:
+        return (r->heap = malloc(sizeof(int) * r->capacity)) ? RC_OK : RC_WRITE_FAILED;
+    case RS_2Q:
+        r->kin = (r->capacity / 4 > 0) ? r->capacity / 4 : 1;
+        return ghosts_init(r, r->capacity / 2, FALSE);
+    case RS_ARC:
+        return ghosts_init(r, r->capacity, FALSE);
+    default:
+        return RC_OK;
+    }
+}
+
+RC replacerInit(Replacer *r, ReplacementStrategy strategy, int capacity, void *stratData) {
+    memset(r, 0, sizeof(Replacer));
+    r->strategy = strategy;
+    r->capacity = capacity;
+    for (int l = 0; l < 2; l++) {
+        r->lists[l].head = r->lists[l].tail = -1;
+        r->lists[l].coldTail = r->lists[l].parkTail = -1;
+        r->ghostLists[l].head = r->ghostLists[l].tail = -1;
+    }
+    r->k = (strategy == RS_LRU_K && stratData) ? *(int *)stratData : 1;
+    if (r->k < 1) return RC_FILE_HANDLE_NOT_INIT;
+    r->frames = calloc(capacity, sizeof(ReplFrame));
+    if (!r->frames) return RC_WRITE_FAILED;
+    for (int i = 0; i < capacity; i++) {
+        r->frames[i].page = NO_PAGE;
+        r->frames[i].prev = r->frames[i].next = -1;
+        r->frames[i].heapPos = -1;
+    }
+    if (strategy_init(r) != RC_OK) {
+        replacerFree(r);
+        return RC_WRITE_FAILED;
+    }
+    return RC_OK;
+}
+
+void replacerFree(Replacer *r) {
+    free(r->frames);
+    free(r->hist);
+    free(r->heap);
+    free(r->ghosts);
+    free(r->ghostHist);
+    free(r->freeGhosts);
+    if (r->ghostMap.slots) ptab_free(&r->ghostMap);
+    memset(r, 0, sizeof(Replacer));
+}
+
+/* ------------ Events ------------ */
+
+static void load(Replacer *r, int f, PageNumber page, long long tick, bool ahead) {
+    ReplFrame *n = &r->frames[f];
+    list_unlink(r, f);
+    if (n->page != NO_PAGE) r->listSize[n->list]--;
+    n->list = 0;
+    r->listSize[0]++;
+    n->page = page;
+    n->loadTick = tick;
+    n->stamp = tick;
+    n->evictable = FALSE;
+    n->refbit = TRUE;
+    n->ahead = ahead;
+    n->cold = FALSE;
+    switch (r->strategy) {
+    case RS_FIFO:
+        list_push_tail(r, f);
+        break;
+    case RS_LRU_K:
+        heap_remove(r, f);
+        n->nrefs = 0;
+        memset(hist(r, f), 0, sizeof(long long) * r->k);
+        if (r->ghosts) ghost_restore(r, f, page);
+        if (!ahead) hist_push(hist(r, f), &n->nrefs, r->k, tick);
+        break;
+    case RS_LFU:
+        heap_remove(r, f);
+        n->nrefs = 0;
+        if (ahead) n->prio = r->age; else lfu_reference(r, f, tick);
+        break;
+    case RS_2Q: {
+        int g = ahead ? -1 : ptab_get(&r->ghostMap, page);
+        if (g >= 0) {
+            ghost_drop(r, g);
+            list_move(r, f, Q2_AM);
+        } else {
+            list_push_tail(r, f);   /* A1in, FIFO: linked from the start */
+        }
+        break;
+    }
+    case RS_ARC:
+        if (!ahead) arc_load(r, f, page);
+        break;
+    default:
+        break;
+    }
+}
+
+void replacerLoad(Replacer *r, int f, PageNumber page, long long tick) {
+    load(r, f, page, tick, FALSE);
+}
+
+void replacerPrefetch(Replacer *r, int f, PageNumber page, long long tick) {
+    load(r, f, page, tick, TRUE);
+}
+
+/* First access to a read-ahead frame (pinned, off the heap): do what its load would have done */
+static void ahead_reference(Replacer *r, int f, PageNumber page, long long tick) {
+    ReplFrame *n = &r->frames[f];
+    n->ahead = FALSE;
+    n->cold = TRUE;
+    switch (r->strategy) {
+    case RS_FIFO:
+        fifo_requeue(r, f);
+        break;
+    case RS_LRU:
+        list_unlink(r, f);
+        break;
+    case RS_LRU_K:
+        hist_push(hist(r, f), &n->nrefs, r->k, tick);
+        n->cold = (n->nrefs == 1);   /* not if it had retained history */
+        break;
+    case RS_LFU:
+        lfu_reference(r, f, tick);
+        break;
+    case RS_2Q: {
+        int g = ptab_get(&r->ghostMap, page);
+        if (g >= 0) {
+            ghost_drop(r, g);
+            list_move(r, f, Q2_AM);
+            n->cold = FALSE;
+        } else {
+            fifo_requeue(r, f);
+        }
+        break;
+    }
+    case RS_ARC:
+        list_unlink(r, f);
+        if (ptab_get(&r->ghostMap, page) >= 0) n->cold = FALSE;
+        arc_load(r, f, page);
+        break;
+    default:
+        break;
+    }
+}
+
+void replacerAccess(Replacer *r, int f, PageNumber page, long long tick) {
+    if (stale(r, f, page, tick)) return;
+    ReplFrame *n = &r->frames[f];
+    n->evictable = FALSE;
+    n->refbit = TRUE;
+    if (r->strategy == RS_LRU_K || r->strategy == RS_LFU) heap_remove(r, f);
+    if (n->ahead) {
+        ahead_reference(r, f, page, tick);
+        return;
+    }
+    n->cold = FALSE;
+    if (r->strategy == RS_LRU || (r->strategy == RS_2Q && n->list == Q2_AM)) list_unlink(r, f);
+    if (r->strategy == RS_ARC) list_move(r, f, ARC_T2);
+    if (r->strategy == RS_LRU_K) hist_push(hist(r, f), &n->nrefs, r->k, tick);
+    if (r->strategy == RS_LFU) lfu_reference(r, f, tick);
+}
+
+void replacerUnpin(Replacer *r, int f, PageNumber page, long long tick) {
+    if (stale(r, f, page, tick)) return;
+    ReplFrame *n = &r->frames[f];
+    n->evictable = TRUE;
+    if (n->cold && r->strategy != RS_LRU_K && r->strategy != RS_LFU) {
+        n->refbit = FALSE;
+        if (r->strategy != RS_CLOCK) cold_release(r, f);
+        return;
+    }
+    switch (r->strategy) {
+    case RS_LRU:
+    case RS_ARC:
+        lru_release(r, f);
+        break;
+    case RS_2Q:
+        if (n->list == Q2_AM) lru_release(r, f); else fifo_rejoin(r, f);
+        break;
+    case RS_FIFO:
+        fifo_rejoin(r, f);
+        break;
+    case RS_LRU_K:
+    case RS_LFU:
+        heap_insert(r, f);
+        break;
+    default:
+        break;
+    }
+}
+
+void replacerPin(Replacer *r, int f) {
+    ReplFrame *n = &r->frames[f];
+    n->evictable = FALSE;
+    if (r->strategy == RS_LRU || r->strategy == RS_ARC || (r->strategy == RS_2Q && n->list == Q2_AM)) list_unlink(r, f);
+    if (r->strategy == RS_LRU_K || r->strategy == RS_LFU) heap_remove(r, f);
+}
+
+void replacerRemove(Replacer *r, int f) {
+    ReplFrame *n = &r->frames[f];
+    list_unlink(r, f);
+    if (n->page == NO_PAGE) return;
+    r->listSize[n->list]--;
+    switch (r->strategy) {
+    case RS_LRU_K:
+        heap_remove(r, f);
+        if (r->ghosts && n->nrefs > 0) ghost_retain(r, f, 0);
+        break;
+    case RS_LFU:
+        heap_remove(r, f);
+        r->age = n->prio;   /* inflate future priorities */
+        break;
+    case RS_2Q:
+        if (n->list == Q2_A1IN && !n->ahead) ghost_retain(r, f, Q2_A1OUT);
+        break;
+    case RS_ARC:
+        if (!n->ahead) ghost_retain(r, f, n->list);   /* T1 -> B1, T2 -> B2; a page never accessed leaves no ghost */
+        break;
+    default:
+        break;
+    }
+    r->frames[f].page = NO_PAGE;
+    r->frames[f].evictable = FALSE;
+    r->frames[f].refbit = FALSE;
+    r->frames[f].ahead = FALSE;
+    r->frames[f].cold = FALSE;
+}
+
+/* ------------ Victim selection ------------ */
+
+static int victim_clock(Replacer *r) {
+    int n = r->capacity;
+    int hand = r->hand % n;
+    for (int scanned = 0; scanned < 2 * n; scanned++) {
+        ReplFrame *f = &r->frames[hand];
+        r->steps++;
+        if (f->page != NO_PAGE && f->evictable) {
+            if (!f->refbit) { r->hand = (hand + 1) % n; return hand; }
+            f->refbit = FALSE;
+        }
+        hand = (hand + 1) % n;
+    }
+    return -1;
+}
+
+static int victim_2q(Replacer *r) {
+    int a1in = fifo_head(r, Q2_A1IN);
+    if (a1in >= 0 && r->listSize[Q2_A1IN] > r->kin) return a1in;
+    int am = r->lists[Q2_AM].head;
+    return (am >= 0) ? am : a1in;
+}
+
+int replacerVictim(Replacer *r, PageNumber page) {
+    if (r->strategy != RS_CLOCK) r->steps++;   /* the frame chosen; CLOCK counts each frame its hand passes */
+    switch (r->strategy) {
+    case RS_CLOCK:
+        return victim_clock(r);
+    case RS_FIFO:
+        return fifo_head(r, 0);
+    case RS_LRU_K:
+    case RS_LFU:
+        return (r->heapSize > 0) ? r->heap[0] : -1;
+    case RS_2Q:
+        return victim_2q(r);
+    case RS_ARC:
+        return victim_arc(r, page);
+    default:
+        return r->lists[0].head;
+    }
+}
+
+/* ------------ Eviction candidates ------------ */
+
+static int collect_list(Replacer *r, int list, int *out, int n, int max) {
+    for (int f = r->lists[list].head; f >= 0 && n < max; f = r->frames[f].next)
+        if (r->frames[f].evictable) out[n++] = f;
+    return n;
+}
+
+/* CLOCK: from the hand, frames without a reference bit first */
+static int collect_clock(Replacer *r, int *out, int max) {
+    int n = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < r->capacity && n < max; i++) {
+            ReplFrame *f = &r->frames[(r->hand + i) % r->capacity];
+            if (f->page != NO_PAGE && f->evictable && f->refbit == (pass == 1)) out[n++] = (r->hand + i) % r->capacity;
+        }
+    }
+    return n;
+}
+
+int replacerCandidates(Replacer *r, int *out, int max) {
+    int first;
+    switch (r->strategy) {
+    case RS_CLOCK:
+        return collect_clock(r, out, max);
+    case RS_LRU_K:
+    case RS_LFU: {
+        int n = 0;
+        for (; n < r->heapSize && n < max; n++) out[n] = r->heap[n];
+        return n;
+    }
+    case RS_2Q:
+        first = (r->listSize[Q2_A1IN] > r->kin) ? Q2_A1IN : Q2_AM;
+        return collect_list(r, 1 - first, out, collect_list(r, first, out, 0, max), max);
+    case RS_ARC:
+        first = (r->listSize[ARC_T1] > r->p) ? ARC_T1 : ARC_T2;
+        return collect_list(r, 1 - first, out, collect_list(r, first, out, 0, max), max);
+    default:
+        return collect_list(r, 0, out, 0, max);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef REPLACER_H
+#define REPLACER_H
+
+#include "buffer_mgr.h"
+#include "page_table.h"
+#include "dt.h"
+
+/*
+ * Replacer — replacement-policy state for a fixed set of frames.
+ * ------------------------------------------------------------
+ * The buffer manager reports what happens to each frame (loaded, accessed,
+ * released, evicted) and asks the replacer which evictable frame to give up
+ * next. The replacer knows nothing about latches, the page table or I/O and is
+ * not thread-safe: the buffer manager calls it under its pool latch.
+ *
+ * Every call is O(1) for FIFO, LRU, 2Q and ARC (amortized for victim
+ * selection from a FIFO-ordered queue); pinned frames never sit on an LRU-ordered list, and
+ * FIFO-ordered queues move a pinned frame off as soon as it reaches the
+ * head, so victim selection never rescans pinned frames. LRU-K and LFU
+ * keep evictable frames in a binary heap (by backward K-distance and by aged
+ * frequency), so their calls are O(log n) plus O(K) history bookkeeping.
+ */
+
+/* A frame's place in one of the replacer's intrusive lists. */
+typedef struct ReplFrame {
+    PageNumber page;      /* page held by the frame, NO_PAGE if empty */
+    long long  loadTick;  /* tick of the last load; older events are stale */
+    long long  stamp;     /* LFU: last reference tick */
+    int        prev, next;
+    int        run;       /* part of its queue it was linked into (REPL_QUEUED/COLD/REJOINED) */
+    int        list;      /* queue the frame belongs to (2Q: A1in/Am, ARC: T1/T2; else 0) */
+    bool       evictable; /* fix count is zero (as far as reported) */
+    bool       linked;    /* currently on its queue */
+    bool       refbit;    /* CLOCK reference bit */
+    int        heapPos;   /* LRU-K/LFU: slot in the victim heap, -1 if not evictable */
+    int        nrefs;     /* LRU-K: references recorded in the history, at most K; LFU: reference count */
+    long long  prio;      /* LFU: nrefs + the aging offset at the last reference */
+    bool       ahead;     /* read ahead and not accessed yet: the load was no reference */
+    bool       cold;      /* accessed once since it was read ahead: released to the eviction end */
+} ReplFrame;
+
+/*
+ * Ghost entry: an evicted page that is remembered (without its data) so a
+ * quick re-reference is not treated as a first one. LRU-K keeps its history
+ * here, 2Q uses it for A1out and ARC for B1/B2.
+ */
+typedef struct ReplGhost {
+    PageNumber page;
+    int        nrefs;
+    int        list;      /* 2Q: A1out; ARC: B1/B2; else 0 */
+    int        prev, next;
+} ReplGhost;
+
+typedef struct ReplList {
+    int head, tail;       /* head = next victim */
+    int coldTail;         /* last frame of the cold run at the head, -1 if none */
+    int parkTail;         /* last parked frame that rejoined (behind the cold run), -1 if none */
+} ReplList;
+
+/* runs of a queue, from the head: cold read-ahead frames, rejoined parked frames, the rest */
+enum { REPL_QUEUED = 0, REPL_COLD = 1, REPL_REJOINED = 2 };
+
+/* list ids of the adaptive policies */
+enum { Q2_A1IN = 0, Q2_AM = 1, Q2_A1OUT = 0 };
+enum { ARC_T1 = 0, ARC_T2 = 1, ARC_B1 = 0, ARC_B2 = 1 };
+
+typedef struct Replacer {
+    ReplacementStrategy strategy;
+    int         capacity;
+    ReplFrame  *frames;
+    ReplList    lists[2];
+    int         listSize[2]; /* resident frames per list, pinned ones included */
+    int         hand;     /* CLOCK hand */
+    int         kin;      /* 2Q: A1in size above which it gives up frames first */
+    int         p;        /* ARC: adaptive target size of T1 */
+    long long   steps;    /* frames examined by replacerVictim so far (statistics) */
+
+    /* LRU-K and LFU */
+    int         k;
+    long long  *hist;     /* capacity*k reference ticks, most recent first */
+    int        *heap;     /* evictable frames, next victim on top */
+    int         heapSize;
+    long long   age;      /* LFU: priority of the last victim, added to new references */
+
+    /* ghosts: LRU-K, 2Q and ARC */
+    ReplGhost  *ghosts;   /* up to ghostCap remembered pages */
+    int         ghostCap;
+    long long  *ghostHist;/* LRU-K: retained reference history, ghostCap*k */
+    PageTable   ghostMap; /* page -> ghost */
+    ReplList    ghostLists[2]; /* oldest at the head */
+    int         ghostSize[2];
+    int        *freeGhosts;
+    int         numFreeGhosts;
+} Replacer;
+
+/* stratData: for RS_LRU_K an int* holding K (NULL means K=1, i.e. plain LRU on access time) */
+RC   replacerInit (Replacer *r, ReplacementStrategy strategy, int capacity, void *stratData);
+void replacerFree (Replacer *r);
+
+/* frame now holds page, freshly read and pinned */
+void replacerLoad (Replacer *r, int frame, PageNumber page, long long tick);
+/*
+ * frame now holds page, read ahead of any request and pinned by the read. It
+ * is not a reference: the first access counts as the load, and the release
+ * after that single access queues the frame to be evicted first, so pages a
+ * scan reads once do not push out the working set.
+ */
+void replacerPrefetch (Replacer *r, int frame, PageNumber page, long long tick);
+/* a pin hit on frame; ignored if the frame was reloaded since the event */
+void replacerAccess (Replacer *r, int frame, PageNumber page, long long tick);
+/* frame's fix count dropped to zero; ignored if stale */
+void replacerUnpin (Replacer *r, int frame, PageNumber page, long long tick);
+/* frame turned out to be pinned when the buffer manager tried to evict it */
+void replacerPin (Replacer *r, int frame);
+/* next frame to evict to make room for page, or -1 if nothing is evictable; does not remove it; adds the frames it examined to steps */
+int  replacerVictim (Replacer *r, PageNumber page);
+/* frame was evicted (or emptied) */
+void replacerRemove (Replacer *r, int frame);
+/*
+ * up to max evictable frames into out, roughly in the order they would be
+ * evicted (LRU-K/LFU: the top levels of the heap); changes nothing
+ */
+int  replacerCandidates (Replacer *r, int *out, int max);
+
+#endif
@@ -1,6 +1,15 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include "storage_mgr.h"
 #include "dberror.h"
 
@@ -19,17 +28,45 @@
  *
  * Notes:
  *  - Each SM_FileHandle has mgmtInfo, which holds a FileCtx
- *    containing the FILE* pointer and a private copy of the filename.
+ *    containing the file descriptor and a private copy of the filename.
+ *  - Pages are transferred with positional pread/pwrite straight between
+ *    the caller's buffer and the kernel: there is no stdio buffer and no
+ *    shared file offset, so readBlock, writeBlock and ensureCapacity may be
+ *    called on one handle from several threads at once. Growing the file is
+ *    serialized by a per-handle lock; the page count that bounds reads and
+ *    writes is published after the new pages exist.
+ *  - readBlocks/writeBlocks move a run of consecutive pages between the file
+ *    and a list of separate page buffers with one preadv/pwritev (per
+ *    SM_IOV_PAGES pages), so the caller's buffers need not be contiguous.
+ *  - curPagePos and totalNumPages in the handle are kept up to date for the
+ *    single-threaded interface; with concurrent callers they are snapshots,
+ *    and the relative read functions (readNextBlock, ...) are not meaningful.
+ *  - The file grows in one fallocate (ftruncate where that is unsupported)
+ *    however many pages are added. ensureCapacity may add more than asked
+ *    for, per the handle's growth policy, so a bulk load does not extend the
+ *    file once per page.
+ *  - Nothing is synced implicitly. syncFile makes completed writes durable
+ *    (fdatasync); the write mode says whether callers are expected to call it
+ *    after a batch of writes, or whether the descriptor is O_DSYNC and every
+ *    write is durable on its own.
  *  - An internal registry keeps track of open files so that
  *    destroyPageFile can close them safely (important on Windows).
  */
 
 /* ------------ Internal structures ------------ */
 
-/* Wraps the FILE pointer and a copy of the file name */
+/* Pages per preadv/pwritev call, well below IOV_MAX */
+#define SM_IOV_PAGES 256
+
+/* Wraps the file descriptor and a copy of the file name */
 typedef struct FileCtx {
-    FILE *fp;
+    int fd;
     char *fname;
+    atomic_int numPages;       /* authoritative page count */
+    SM_WriteMode mode;
+    int growMinPages;          /* growth policy, under growLock */
+    int growPercent;
+    pthread_mutex_t growLock;  /* serializes extending the file */
 } FileCtx;
 
 /* Local strdup replacement (some environments lack it) */
@@ -44,46 +81,45 @@ static char *sm_strdup(const char *s) {
 /* Linked list of currently open files for deletion safety */
 typedef struct OpenReg {
     char *name;
-    FILE *fp;
+    int fd;
     struct OpenReg *next;
 } OpenReg;
 
 static OpenReg *openList = NULL;
+static pthread_mutex_t openListLock = PTHREAD_MUTEX_INITIALIZER;
 
 /* ------------ Registry helpers ------------ */
 
 /* Add a file entry to the open file list */
-static void register_open(const char *name, FILE *fp) {
+static void register_open(const char *name, int fd) {
     OpenReg *r = calloc(1, sizeof(OpenReg));
     if (!r) return;
     r->name = sm_strdup(name);
-    r->fp = fp;
+    r->fd = fd;
+    pthread_mutex_lock(&openListLock);
     r->next = openList;
     openList = r;
+    pthread_mutex_unlock(&openListLock);
 }
 
-/* Remove a file entry (matched by FILE* or filename) */
-static void unregister_open(const char *name, FILE *fp) {
+/* Remove a file entry (matched by descriptor, or by filename if fd < 0); returns its descriptor or -1 */
+static int unregister_open(const char *name, int fd) {
+    int found = -1;
+    pthread_mutex_lock(&openListLock);
     OpenReg **pp = &openList;
     while (*pp) {
         OpenReg *cur = *pp;
-        if ((fp && cur->fp == fp) || (name && cur->name && strcmp(cur->name, name) == 0)) {
+        if ((fd >= 0 && cur->fd == fd) || (fd < 0 && name && cur->name && strcmp(cur->name, name) == 0)) {
             *pp = cur->next;
+            found = cur->fd;
             free(cur->name);
             free(cur);
-            return;
+            break;
         }
         pp = &cur->next;
     }
-}
-
-/* Find a FILE* by filename */
-static FILE *lookup_open(const char *name) {
-    for (OpenReg *p = openList; p; p = p->next) {
-        if (p->name && strcmp(p->name, name) == 0)
-            return p->fp;
-    }
-    return NULL;
+    pthread_mutex_unlock(&openListLock);
+    return found;
 }
 
 /* ------------ Utility functions ------------ */
@@ -99,18 +135,60 @@ static FileCtx *ctx(SM_FileHandle *h) {
 }
 
 /* Compute byte offset for a given page number */
-static long pageOffset(int pageNum) {
-    return (long)pageNum * (long)PAGE_SIZE;
+static off_t pageOffset(int pageNum) {
+    return (off_t)pageNum * (off_t)PAGE_SIZE;
 }
 
-/* Read one full page from file */
-static RC fread_page(FILE *fp, void *buf) {
-    return (fread(buf, 1, PAGE_SIZE, fp) == PAGE_SIZE) ? RC_OK : RC_READ_NON_EXISTING_PAGE;
+/* Publish handle fields that concurrent readers/writers of the same handle also store */
+static void set_int(int *field, int v) {
+    __atomic_store_n(field, v, __ATOMIC_RELAXED);
+}
+
+/* Read one full page at off; short reads (end of file) fail */
+static RC pread_page(int fd, void *buf, off_t off) {
+    size_t done = 0;
+    while (done < PAGE_SIZE) {
+        ssize_t n = pread(fd, (char *)buf + done, PAGE_SIZE - done, off + (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return RC_READ_NON_EXISTING_PAGE;
+        done += (size_t)n;
+    }
+    return RC_OK;
 }
 
-/* Write one full page to file */
-static RC fwrite_page(FILE *fp, const void *buf) {
-    return (fwrite(buf, 1, PAGE_SIZE, fp) == PAGE_SIZE) ? RC_OK : RC_WRITE_FAILED;
+/* Write one full page at off */
+static RC pwrite_page(int fd, const void *buf, off_t off) {
+    size_t done = 0;
+    while (done < PAGE_SIZE) {
+        ssize_t n = pwrite(fd, (const char *)buf + done, PAGE_SIZE - done, off + (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return RC_WRITE_FAILED;
+        done += (size_t)n;
+    }
+    return RC_OK;
+}
+
+/* Move pages [0, n) of a run starting at off with as few preadv/pwritev calls as possible, resuming after short transfers */
+static RC transfer_pages(int fd, SM_PageHandle *pages, int n, off_t off, int out) {
+    struct iovec iov[SM_IOV_PAGES];
+    int first = 0;
+    size_t skip = 0;   /* bytes of pages[first] already transferred */
+    while (first < n) {
+        int cnt = 0;
+        for (; cnt < SM_IOV_PAGES && first + cnt < n; cnt++) {
+            size_t from = (cnt == 0) ? skip : 0;
+            iov[cnt].iov_base = pages[first + cnt] + from;
+            iov[cnt].iov_len = PAGE_SIZE - from;
+        }
+        off_t at = off + pageOffset(first) + (off_t)skip;
+        ssize_t r = out ? pwritev(fd, iov, cnt, at) : preadv(fd, iov, cnt, at);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return out ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+        size_t done = skip + (size_t)r;
+        first += (int)(done / PAGE_SIZE);
+        skip = done % PAGE_SIZE;
+    }
+    return RC_OK;
 }
 
 /* ------------ Public API implementation ------------ */
@@ -122,19 +200,18 @@ void initStorageManager(void) { }
 RC createPageFile(char *fileName) {
     if (!fileName) return RC_WRITE_FAILED;
 
-    FILE *fp = fopen(fileName, "wb+");
-    if (!fp) return RC_WRITE_FAILED;
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return RC_WRITE_FAILED;
 
     char *blank = calloc(PAGE_SIZE, 1);   // allocate a zeroed page
-    if (!blank) { fclose(fp); remove(fileName); return RC_WRITE_FAILED; }
+    if (!blank) { close(fd); remove(fileName); return RC_WRITE_FAILED; }
 
-    RC rc = fwrite_page(fp, blank);
+    RC rc = pwrite_page(fd, blank, 0);
     free(blank);
 
-    if (rc != RC_OK) { fclose(fp); remove(fileName); return rc; }
+    if (rc != RC_OK) { close(fd); remove(fileName); return rc; }
 
-    fflush(fp);
-    fclose(fp);
+    close(fd);
     return RC_OK;
 }
 
@@ -142,26 +219,27 @@ RC createPageFile(char *fileName) {
 RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
     if (!fileName || !fHandle) return RC_FILE_HANDLE_NOT_INIT;
 
-    FILE *fp = fopen(fileName, "rb+");
-    if (!fp) return RC_FILE_NOT_FOUND;
+    int fd = open(fileName, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return RC_FILE_NOT_FOUND;
 
     /* Determine number of pages in the file */
-    if (fseek(fp, 0, SEEK_END) != 0) { fclose(fp); return RC_FILE_NOT_FOUND; }
-    long fsize = ftell(fp);
-    if (fsize < 0) { fclose(fp); return RC_FILE_NOT_FOUND; }
-    int pages = (int)((fsize + PAGE_SIZE - 1) / PAGE_SIZE);
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return RC_FILE_NOT_FOUND; }
+    int pages = (int)((st.st_size + PAGE_SIZE - 1) / PAGE_SIZE);
 
     FileCtx *c = calloc(1, sizeof(FileCtx));
-    if (!c) { fclose(fp); return RC_FILE_HANDLE_NOT_INIT; }
-    c->fp = fp;
+    if (!c) { close(fd); return RC_FILE_HANDLE_NOT_INIT; }
+    c->fd = fd;
     c->fname = sm_strdup(fileName);
+    atomic_init(&c->numPages, pages);
+    pthread_mutex_init(&c->growLock, NULL);
 
     fHandle->fileName = fileName;
     fHandle->totalNumPages = pages;
     fHandle->curPagePos = (pages > 0 ? 0 : -1);
     fHandle->mgmtInfo = c;
 
-    register_open(fileName, fp);
+    register_open(fileName, fd);
     return RC_OK;
 }
 
@@ -170,8 +248,9 @@ RC closePageFile(SM_FileHandle *fHandle) {
     if (!validHandle(fHandle)) return RC_FILE_HANDLE_NOT_INIT;
 
     FileCtx *c = ctx(fHandle);
-    unregister_open(c->fname, c->fp);
-    int status = fclose(c->fp);
+    unregister_open(c->fname, c->fd);
+    int status = close(c->fd);
+    pthread_mutex_destroy(&c->growLock);
     free(c->fname);
     free(c);
 
@@ -186,26 +265,77 @@ RC closePageFile(SM_FileHandle *fHandle) {
 RC destroyPageFile(char *fileName) {
     if (!fileName) return RC_FILE_NOT_FOUND;
 
-    FILE *fp = lookup_open(fileName);
-    if (fp) {
-        fclose(fp);
-        unregister_open(fileName, NULL);
-    }
+    int fd = unregister_open(fileName, -1);
+    if (fd >= 0) close(fd);
     return (remove(fileName) == 0) ? RC_OK : RC_FILE_NOT_FOUND;
 }
 
+/* ------------ Layering ------------ */
+
+int getFileDescriptor(SM_FileHandle *fHandle) {
+    return validHandle(fHandle) ? ctx(fHandle)->fd : -1;
+}
+
+/* Page count as published by the last extension; unlike fHandle->totalNumPages, safe under concurrent growth */
+int getTotalNumPages(SM_FileHandle *fHandle) {
+    return validHandle(fHandle) ? atomic_load(&ctx(fHandle)->numPages) : 0;
+}
+
+/* ------------ Durability ------------ */
+
+/* Make every completed write on the handle durable */
+RC syncFile(SM_FileHandle *fHandle) {
+    if (!validHandle(fHandle)) return RC_FILE_HANDLE_NOT_INIT;
+    return (fdatasync(ctx(fHandle)->fd) == 0) ? RC_OK : RC_WRITE_FAILED;
+}
+
+/*
+ * Switch the handle's write mode. Entering or leaving SM_WRITE_DSYNC reopens
+ * the file and swaps the new descriptor in with dup2, so the descriptor
+ * number stays the same; no I/O may be in flight on the handle meanwhile.
+ */
+RC setWriteMode(SM_FileHandle *fHandle, SM_WriteMode mode) {
+    if (!validHandle(fHandle) || mode < SM_WRITE_BUFFERED || mode > SM_WRITE_DSYNC) return RC_FILE_HANDLE_NOT_INIT;
+
+    FileCtx *c = ctx(fHandle);
+    if ((mode == SM_WRITE_DSYNC) != (c->mode == SM_WRITE_DSYNC)) {
+        if (fdatasync(c->fd) != 0) return RC_WRITE_FAILED;   /* leaving O_DSYNC must not lose durability */
+        int fd = open(c->fname, O_RDWR | O_CLOEXEC | (mode == SM_WRITE_DSYNC ? O_DSYNC : 0));
+        if (fd < 0) return RC_FILE_NOT_FOUND;
+        int ok = dup2(fd, c->fd) >= 0;
+        close(fd);
+        if (!ok) return RC_FILE_HANDLE_NOT_INIT;
+    }
+    c->mode = mode;
+    return RC_OK;
+}
+
+SM_WriteMode getWriteMode(SM_FileHandle *fHandle) {
+    return validHandle(fHandle) ? ctx(fHandle)->mode : SM_WRITE_BUFFERED;
+}
+
 /* ------------ Reading operations ------------ */
 
 /* Read a page at a given index into memPage */
 RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
     if (!validHandle(fHandle) || !memPage) return RC_FILE_HANDLE_NOT_INIT;
-    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) return RC_READ_NON_EXISTING_PAGE;
+    FileCtx *c = ctx(fHandle);
+    if (pageNum < 0 || pageNum >= atomic_load(&c->numPages)) return RC_READ_NON_EXISTING_PAGE;
 
+    RC rc = pread_page(c->fd, memPage, pageOffset(pageNum));
+    if (rc == RC_OK) set_int(&fHandle->curPagePos, pageNum);
+    return rc;
+}
+
+/* Read pages firstPage .. firstPage+numPages-1 into memPages[0 .. numPages-1] */
+RC readBlocks(int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages) {
+    if (!validHandle(fHandle) || !memPages || numPages < 0) return RC_FILE_HANDLE_NOT_INIT;
     FileCtx *c = ctx(fHandle);
-    if (fseek(c->fp, pageOffset(pageNum), SEEK_SET) != 0) return RC_READ_NON_EXISTING_PAGE;
+    if (firstPage < 0 || firstPage > atomic_load(&c->numPages) - numPages) return RC_READ_NON_EXISTING_PAGE;
+    if (numPages == 0) return RC_OK;
 
-    RC rc = fread_page(c->fp, memPage);
-    if (rc == RC_OK) fHandle->curPagePos = pageNum;
+    RC rc = transfer_pages(c->fd, memPages, numPages, pageOffset(firstPage), 0);
+    if (rc == RC_OK) set_int(&fHandle->curPagePos, firstPage + numPages - 1);
     return rc;
 }
 
@@ -236,16 +366,23 @@ RC readLastBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
 /* Write a full page at the specified index */
 RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
     if (!validHandle(fHandle) || !memPage) return RC_FILE_HANDLE_NOT_INIT;
-    if (pageNum < 0 || pageNum >= fHandle->totalNumPages) return RC_WRITE_FAILED;
+    FileCtx *c = ctx(fHandle);
+    if (pageNum < 0 || pageNum >= atomic_load(&c->numPages)) return RC_WRITE_FAILED;
 
+    RC rc = pwrite_page(c->fd, memPage, pageOffset(pageNum));
+    if (rc == RC_OK) set_int(&fHandle->curPagePos, pageNum);
+    return rc;
+}
+
+/* Write memPages[0 .. numPages-1] to pages firstPage .. firstPage+numPages-1 */
+RC writeBlocks(int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages) {
+    if (!validHandle(fHandle) || !memPages || numPages < 0) return RC_FILE_HANDLE_NOT_INIT;
     FileCtx *c = ctx(fHandle);
-    if (fseek(c->fp, pageOffset(pageNum), SEEK_SET) != 0) return RC_WRITE_FAILED;
+    if (firstPage < 0 || firstPage > atomic_load(&c->numPages) - numPages) return RC_WRITE_FAILED;
+    if (numPages == 0) return RC_OK;
 
-    RC rc = fwrite_page(c->fp, memPage);
-    if (rc == RC_OK) {
-        fflush(c->fp);
-        fHandle->curPagePos = pageNum;
-    }
+    RC rc = transfer_pages(c->fd, memPages, numPages, pageOffset(firstPage), 1);
+    if (rc == RC_OK) set_int(&fHandle->curPagePos, firstPage + numPages - 1);
     return rc;
 }
 
@@ -254,31 +391,59 @@ RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
     return writeBlock(fHandle->curPagePos, fHandle, memPage);
 }
 
+/* Extend the file with zeroed pages up to `pages` in one call; caller holds growLock */
+static RC extend_locked(SM_FileHandle *fHandle, int pages) {
+    FileCtx *c = ctx(fHandle);
+    int cur = atomic_load(&c->numPages);
+    if (pages <= cur) return RC_OK;
+
+    int r;
+    do {
+        r = fallocate(c->fd, 0, pageOffset(cur), pageOffset(pages) - pageOffset(cur));
+    } while (r != 0 && errno == EINTR);
+    if (r != 0 && (errno == EOPNOTSUPP || errno == ENOSYS)) r = ftruncate(c->fd, pageOffset(pages));   /* sparse, reads as zeros */
+    if (r != 0) return RC_WRITE_FAILED;
+
+    atomic_store(&c->numPages, pages);   /* only now may the pages be read or written */
+    set_int(&fHandle->totalNumPages, pages);
+    return RC_OK;
+}
+
 /* Append a new blank page at the end of the file */
 RC appendEmptyBlock(SM_FileHandle *fHandle) {
     if (!validHandle(fHandle)) return RC_FILE_HANDLE_NOT_INIT;
 
     FileCtx *c = ctx(fHandle);
-    if (fseek(c->fp, 0, SEEK_END) != 0) return RC_WRITE_FAILED;
-
-    char *blank = calloc(PAGE_SIZE, 1);
-    if (!blank) return RC_WRITE_FAILED;
-    RC rc = fwrite_page(c->fp, blank);
-    free(blank);
-
-    if (rc == RC_OK) {
-        fflush(c->fp);
-        fHandle->totalNumPages++;
-    }
+    pthread_mutex_lock(&c->growLock);
+    RC rc = extend_locked(fHandle, atomic_load(&c->numPages) + 1);
+    pthread_mutex_unlock(&c->growLock);
     return rc;
 }
 
-/* Grow the file until it contains at least numberOfPages */
+/* Grow the file until it contains at least numberOfPages, rounding the growth up per the growth policy */
 RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
     if (!validHandle(fHandle)) return RC_FILE_HANDLE_NOT_INIT;
-    while (fHandle->totalNumPages < numberOfPages) {
-        RC rc = appendEmptyBlock(fHandle);
-        if (rc != RC_OK) return rc;
-    }
+
+    FileCtx *c = ctx(fHandle);
+    if (atomic_load(&c->numPages) >= numberOfPages) return RC_OK;   /* common case: no lock */
+
+    pthread_mutex_lock(&c->growLock);
+    int cur = atomic_load(&c->numPages);
+    long long chunk = (long long)cur * c->growPercent / 100;
+    if (chunk < c->growMinPages) chunk = c->growMinPages;
+    long long target = (cur + chunk > INT_MAX) ? INT_MAX : cur + chunk;
+    RC rc = extend_locked(fHandle, (target > numberOfPages) ? (int)target : numberOfPages);
+    pthread_mutex_unlock(&c->growLock);
+    return rc;
+}
+
+RC setGrowthPolicy(SM_FileHandle *fHandle, int minPages, int percent) {
+    if (!validHandle(fHandle) || minPages < 0 || percent < 0) return RC_FILE_HANDLE_NOT_INIT;
+
+    FileCtx *c = ctx(fHandle);
+    pthread_mutex_lock(&c->growLock);
+    c->growMinPages = minPages;
+    c->growPercent = percent;
+    pthread_mutex_unlock(&c->growLock);
     return RC_OK;
 }
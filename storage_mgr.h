@@ -15,6 +15,13 @@ typedef struct SM_FileHandle {
 
 typedef char* SM_PageHandle;
 
+/* How writes on a handle reach stable storage */
+typedef enum SM_WriteMode {
+	SM_WRITE_BUFFERED = 0,      /* writes land in the OS page cache; durable only after syncFile */
+	SM_WRITE_SYNC_ON_FLUSH = 1, /* as buffered, but the buffer manager syncs once per flush batch */
+	SM_WRITE_DSYNC = 2          /* the file is opened O_DSYNC: every write is durable when it returns */
+} SM_WriteMode;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
@@ -33,11 +40,25 @@ extern RC readPreviousBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readNextBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC readLastBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
+/* a run of consecutive pages into separate buffers, one preadv per run */
+extern RC readBlocks (int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages);
 
 /* writing blocks to a page file */
 extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
+extern RC writeBlocks (int firstPage, int numPages, SM_FileHandle *fHandle, SM_PageHandle *memPages);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
 extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+/* growth chunk for ensureCapacity: at least minPages and percent% of the file (0, 0 = exact) */
+extern RC setGrowthPolicy (SM_FileHandle *fHandle, int minPages, int percent);
+
+/* for I/O engines layered on a handle (async_io.c): the descriptor and the current page count */
+extern int getFileDescriptor (SM_FileHandle *fHandle);
+extern int getTotalNumPages (SM_FileHandle *fHandle);
+
+/* durability */
+extern RC syncFile (SM_FileHandle *fHandle);
+extern RC setWriteMode (SM_FileHandle *fHandle, SM_WriteMode mode);
+extern SM_WriteMode getWriteMode (SM_FileHandle *fHandle);
 
 #endif
@@ -1,12 +1,22 @@
+#define _POSIX_C_SOURCE 200809L
 #include "storage_mgr.h"
 #include "buffer_mgr_stat.h"
 #include "buffer_mgr.h"
+#include "wal.h"
+#include "double_write.h"
+#include "trace.h"
+#include "probe.h"
+#include "page_table.h"
+#include "replacer.h"
 #include "dberror.h"
 #include "test_helper.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <sys/stat.h>
 
 // var to store the current test's name
 char *testName;
@@ -34,6 +44,25 @@ static void createDummyPages(BM_BufferPool *bm, int num);
 static void checkDummyPages(BM_BufferPool *bm, int num);
 
 static void testReadPage (void);
+static void testPageTable (void);
+static void testReplacerQueues (void);
+static void testPoolOptions (void);
+static void testWriteModes (void);
+static void testFileGrowth (void);
+static void testAsyncIO (void);
+static void testConcurrentMisses (void);
+static void testConcurrentHits (void);
+static void testReadAhead (void);
+static void testVectoredIO (void);
+static void testFlushRuns (void);
+static void testBackgroundWriter (void);
+static void testWriteAheadLog (void);
+static void testDoubleWrite (void);
+static void testFuzzyCheckpoint (void);
+static void testTraceRecorder (void);
+static void testPoolStats (void);
+static void testProbeExport (void);
+static void testThreadLocalErrors (void);
 
 static void testFIFO (void);
 static void testLRU (void);
@@ -47,6 +76,25 @@ main (void)
 
   testCreatingAndReadingDummyPages();
   testReadPage();
+  testPageTable();
+  testReplacerQueues();
+  testPoolOptions();
+  testWriteModes();
+  testFileGrowth();
+  testAsyncIO();
+  testConcurrentMisses();
+  testConcurrentHits();
+  testReadAhead();
+  testVectoredIO();
+  testFlushRuns();
+  testBackgroundWriter();
+  testWriteAheadLog();
+  testDoubleWrite();
+  testFuzzyCheckpoint();
+  testTraceRecorder();
+  testPoolStats();
+  testProbeExport();
+  testThreadLocalErrors();
   testFIFO();
   testLRU();
 }
@@ -148,6 +196,1389 @@ testReadPage ()
   TEST_DONE();
 }
 
+#define PT_KEYS 2000
+#define PT_ROUNDS 20000
+
+// every key in [0, PT_KEYS) is found exactly when the reference says it is present
+static void
+checkPageTable (PageTable *t, const int *ref, const char *message)
+{
+  int i, bad = 0, count = 0;
+
+  for (i = 0; i < PT_KEYS; i++)
+    {
+      bad += ptab_get(t, i) != ref[i];
+      count += ref[i] >= 0;
+    }
+  ASSERT_TRUE(bad == 0 && t->count == count, message);
+}
+
+// backward-shift deletion inside a collision cluster, and growth under insert/delete churn
+void
+testPageTable (void)
+{
+  PageTable t;
+  int ref[PT_KEYS];
+  int cluster[6], n = 0;
+  int i, k, mask;
+  testName = "Page table deletion and growth";
+
+  for (i = 0; i < PT_KEYS; i++)
+    ref[i] = -1;
+  CHECK(ptab_init(&t, 6));
+  mask = t.cap - 1;
+
+  // a cluster that wraps around the end of the table: a key at its home slot 2, inserted first, then two keys
+  // hashing to the last slot and three to slot 0, which fill slots 31, 0, 1, 3 and 4 around it
+  for (k = 0; k < PT_KEYS && n < 1; k++)
+    if ((hash_page(k) & mask) == 2)
+      cluster[n++] = k;
+  for (k = 0; k < PT_KEYS && n < 3; k++)
+    if ((int) (hash_page(k) & mask) == mask)
+      cluster[n++] = k;
+  for (k = 0; k < PT_KEYS && n < 6; k++)
+    if ((hash_page(k) & mask) == 0)
+      cluster[n++] = k;
+  ASSERT_EQUALS_INT(6, n, "colliding keys found");
+  for (i = 0; i < n; i++)
+    {
+      CHECK(ptab_put(&t, cluster[i], i));
+      ref[cluster[i]] = i;
+    }
+  checkPageTable(&t, ref, "cluster inserted");
+
+  // delete from the middle: the entries behind shift back, except the one already at its home slot
+  ptab_del(&t, cluster[2]);
+  ref[cluster[2]] = -1;
+  checkPageTable(&t, ref, "deleted from the middle of the cluster");
+  ptab_del(&t, cluster[1]);
+  ref[cluster[1]] = -1;
+  checkPageTable(&t, ref, "deleted the head of the cluster");
+  ptab_del(&t, cluster[5]);
+  ref[cluster[5]] = -1;
+  checkPageTable(&t, ref, "deleted the tail of the cluster");
+  ptab_del(&t, cluster[1]);
+  checkPageTable(&t, ref, "deleting an absent key changes nothing");
+
+  // grow the table past the cluster, then churn: mappings survive every grow and every deletion
+  for (i = 0; i < 200; i++)
+    {
+      CHECK(ptab_put(&t, PT_KEYS - 1 - i, i));
+      ref[PT_KEYS - 1 - i] = i;
+    }
+  ASSERT_TRUE(t.cap > mask + 1, "table grew");
+  checkPageTable(&t, ref, "cluster intact after growing");
+  srand(42);
+  for (i = 0; i < PT_ROUNDS; i++)
+    {
+      k = rand() % PT_KEYS;
+      if (ref[k] >= 0 && rand() % 2)
+        {
+          ptab_del(&t, k);
+          ref[k] = -1;
+        }
+      else
+        {
+          CHECK(ptab_put(&t, k, i));
+          ref[k] = i;
+        }
+      if (i % 1000 == 0)
+        checkPageTable(&t, ref, "mappings intact under churn");
+    }
+  checkPageTable(&t, ref, "mappings intact after churn");
+  ptab_free(&t);
+
+  TEST_DONE();
+}
+
+// the evictable frames of r, next victim first, are exactly expect[0..n)
+static void
+checkQueue (Replacer *r, const int *expect, int n, const char *message)
+{
+  int out[8];
+  int got = replacerCandidates(r, out, 8);
+
+  ASSERT_TRUE(got == n && memcmp(out, expect, sizeof(int) * n) == 0, message);
+}
+
+// FIFO queue runs: parked frames rejoin behind the cold run in release order, and the run ends survive removals
+void
+testReplacerQueues (void)
+{
+  Replacer r;
+  long long t = 0;
+  int f;
+  testName = "Replacer queue runs";
+
+  CHECK(replacerInit(&r, RS_FIFO, 4, NULL));
+  for (f = 0; f < 4; f++)
+    replacerLoad(&r, f, f, ++t);
+  replacerUnpin(&r, 2, 2, ++t);
+  replacerUnpin(&r, 3, 3, ++t);
+  ASSERT_EQUALS_INT(2, replacerVictim(&r, 4), "pinned frames at the head are parked");
+  checkQueue(&r, (int[]) {2, 3}, 2, "parked frames are off the queue");
+  replacerUnpin(&r, 1, 1, ++t);
+  replacerUnpin(&r, 0, 0, ++t);
+  checkQueue(&r, (int[]) {1, 0, 2, 3}, 4, "released parked frames rejoin at the front in release order");
+
+  // a read-ahead page released after a single access goes in front of the rejoined frames
+  replacerRemove(&r, 2);
+  replacerPrefetch(&r, 2, 10, ++t);
+  replacerAccess(&r, 2, 10, ++t);
+  replacerUnpin(&r, 2, 10, ++t);
+  checkQueue(&r, (int[]) {2, 1, 0, 3}, 4, "cold frame at the head");
+  replacerRemove(&r, 3);
+  replacerPrefetch(&r, 3, 11, ++t);
+  replacerAccess(&r, 3, 11, ++t);
+  replacerUnpin(&r, 3, 11, ++t);
+  checkQueue(&r, (int[]) {2, 3, 1, 0}, 4, "cold frames in release order");
+
+  // empty the cold run from its head and its tail, then the rejoined run from its tail
+  replacerRemove(&r, 2);
+  replacerRemove(&r, 3);
+  replacerLoad(&r, 2, 12, ++t);
+  replacerUnpin(&r, 2, 12, ++t);
+  replacerPrefetch(&r, 3, 13, ++t);
+  replacerAccess(&r, 3, 13, ++t);
+  replacerUnpin(&r, 3, 13, ++t);
+  checkQueue(&r, (int[]) {3, 1, 0, 2}, 4, "new cold run after the old one was emptied");
+  replacerRemove(&r, 0);
+  replacerRemove(&r, 1);
+  checkQueue(&r, (int[]) {3, 2}, 2, "rejoined run emptied from its tail");
+
+  // park everything and release it again: the rejoined run restarts behind the cold run
+  replacerLoad(&r, 0, 14, ++t);
+  replacerLoad(&r, 1, 15, ++t);
+  replacerAccess(&r, 3, 13, ++t);
+  replacerAccess(&r, 2, 12, ++t);
+  ASSERT_EQUALS_INT(-1, replacerVictim(&r, 16), "all frames pinned");
+  replacerUnpin(&r, 1, 15, ++t);
+  replacerUnpin(&r, 3, 13, ++t);
+  replacerUnpin(&r, 0, 14, ++t);
+  checkQueue(&r, (int[]) {1, 3, 0}, 3, "rejoined run rebuilt in release order");
+  replacerFree(&r);
+
+  TEST_DONE();
+}
+
+void
+testPoolOptions (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions opts;
+  char *first;
+  int i;
+  testName = "Pool with huge pages and a NUMA node preference";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 10);
+
+  initPoolOptions(&opts);
+  opts.hugePages = TRUE;
+  opts.numaNode = 0;
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &opts));
+
+  // empty frames are used in order and their data is one contiguous, page-aligned block
+  CHECK(pinPage(bm, h, 0));
+  first = h->data;
+  ASSERT_TRUE(((size_t) first % PAGE_SIZE) == 0, "frame data is page aligned");
+  CHECK(unpinPage(bm,h));
+  for (i = 1; i < 3; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      ASSERT_TRUE(h->data == first + i * PAGE_SIZE, "frames are contiguous");
+      ASSERT_EQUALS_STRING(i == 1 ? "Page-1" : "Page-2", h->data, "reading page content");
+      CHECK(unpinPage(bm,h));
+    }
+
+  CHECK(shutdownBufferPool(bm));
+  checkDummyPages(bm, 10);
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+void
+testWriteModes (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions opts;
+  SM_FileHandle fh;
+  SM_WriteMode mode;
+  char page[PAGE_SIZE] = "Page-2";
+  int i;
+  testName = "Write modes and flush batches";
+
+  for (mode = SM_WRITE_BUFFERED; mode <= SM_WRITE_DSYNC; mode++)
+    {
+      CHECK(createPageFile("testbuffer.bin"));
+      initPoolOptions(&opts);
+      opts.writeMode = mode;
+      CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &opts));
+
+      // write three pages and flush them as one batch
+      for (i = 0; i < 3; i++)
+        {
+          CHECK(pinPage(bm, h, i));
+          sprintf(h->data, "%s-%i", "Page", h->pageNum);
+          CHECK(markDirty(bm, h));
+          CHECK(unpinPage(bm,h));
+        }
+      CHECK(forceFlushPool(bm));
+      ASSERT_EQUALS_INT(3, getNumWriteIO(bm), "each dirty page written once");
+      CHECK(shutdownBufferPool(bm));
+      checkDummyPages(bm, 3);
+
+      // the mode can be switched on an open handle
+      CHECK(openPageFile("testbuffer.bin", &fh));
+      ASSERT_TRUE(getWriteMode(&fh) == SM_WRITE_BUFFERED, "files open buffered");
+      CHECK(setWriteMode(&fh, mode));
+      ASSERT_TRUE(getWriteMode(&fh) == mode, "write mode set");
+      CHECK(writeBlock(2, &fh, page));
+      CHECK(syncFile(&fh));
+      CHECK(setWriteMode(&fh, SM_WRITE_BUFFERED));
+      CHECK(closePageFile(&fh));
+
+      CHECK(destroyPageFile("testbuffer.bin"));
+    }
+
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+void
+testFileGrowth (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  char page[PAGE_SIZE];
+  int i, zero;
+  testName = "Growing the page file";
+
+  // exact growth: pinning far past the end extends the file to just that page
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, 1000));
+  for (i = 0, zero = 1; i < PAGE_SIZE; i++)
+    zero &= (h->data[i] == 0);
+  ASSERT_TRUE(zero, "new page reads as zeros");
+  CHECK(unpinPage(bm,h));
+  CHECK(shutdownBufferPool(bm));
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  ASSERT_EQUALS_INT(1001, fh.totalNumPages, "file extended to the pinned page");
+
+  // chunked growth: at least 64 pages or 10% at a time
+  CHECK(setGrowthPolicy(&fh, 64, 10));
+  CHECK(ensureCapacity(1002, &fh));
+  ASSERT_EQUALS_INT(1101, fh.totalNumPages, "grown by 10%");
+  CHECK(ensureCapacity(1101, &fh));
+  ASSERT_EQUALS_INT(1101, fh.totalNumPages, "no growth when large enough");
+  CHECK(appendEmptyBlock(&fh));
+  ASSERT_EQUALS_INT(1102, fh.totalNumPages, "append adds exactly one page");
+  CHECK(readBlock(1101, &fh, page));
+  CHECK(closePageFile(&fh));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+static void
+countCompletion (IORequest *req)
+{
+  (*(int *) req->userData)++;
+}
+
+void
+testAsyncIO (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PoolOptions opts;
+  SM_FileHandle fh;
+  IOEngine *e;
+  IORequest reqs[8];
+  char bufs[8][PAGE_SIZE];
+  char expected[32];
+  IOBackend backend;
+  int i, completed;
+  testName = "Async I/O engine";
+
+  for (backend = IO_BACKEND_AUTO; backend <= IO_BACKEND_THREADS; backend++)
+    {
+      CHECK(createPageFile("testbuffer.bin"));
+      createDummyPages(bm, 8);
+      CHECK(openPageFile("testbuffer.bin", &fh));
+      if (ioe_init(&e, &fh, backend, 4, 2) != RC_OK)
+        {
+          // io_uring may be unavailable or disabled; the other backends must work
+          ASSERT_TRUE(backend == IO_BACKEND_URING, "only io_uring may be unavailable");
+          CHECK(closePageFile(&fh));
+          CHECK(destroyPageFile("testbuffer.bin"));
+          continue;
+        }
+
+      // a batch larger than the queue depth, with completion callbacks
+      memset(reqs, 0, sizeof(reqs));
+      completed = 0;
+      for (i = 0; i < 8; i++)
+        {
+          reqs[i].op = IO_READ;
+          reqs[i].pageNum = 7 - i;
+          reqs[i].buf = bufs[i];
+          reqs[i].done = countCompletion;
+          reqs[i].userData = &completed;
+        }
+      ioe_submit(e, reqs, 8);
+      for (i = 0; i < 8; i++)
+        {
+          while (!ioe_done(&reqs[i]))
+            ;
+          ASSERT_TRUE(reqs[i].rc == RC_OK, "read completed");
+          sprintf(expected, "%s-%i", "Page", 7 - i);
+          ASSERT_EQUALS_STRING(expected, bufs[i], "read page content");
+        }
+
+      // single requests waited on with ioe_wait, and errors
+      sprintf(bufs[0], "%s-%i", "Page", 100);
+      memset(reqs, 0, 3 * sizeof(IORequest));
+      reqs[0].op = IO_WRITE;
+      reqs[0].pageNum = 3;
+      reqs[0].buf = bufs[0];
+      reqs[1].op = IO_READ;
+      reqs[1].pageNum = 3;
+      reqs[1].buf = bufs[1];
+      reqs[2].op = IO_READ;
+      reqs[2].pageNum = 8;
+      reqs[2].buf = bufs[2];
+      for (i = 0; i < 2; i++)
+        {
+          ioe_submit(e, &reqs[i], 1);
+          CHECK(ioe_wait(e, &reqs[i]));
+        }
+      ASSERT_EQUALS_STRING("Page-100", bufs[1], "written page read back");
+      ioe_submit(e, &reqs[2], 1);
+      ASSERT_TRUE(ioe_wait(e, &reqs[2]) == RC_READ_NON_EXISTING_PAGE, "reading past the end fails");
+
+      ioe_free(e);
+      ASSERT_EQUALS_INT(8, completed, "every callback ran");
+      CHECK(closePageFile(&fh));
+      CHECK(destroyPageFile("testbuffer.bin"));
+
+      // a pool on this backend
+      CHECK(createPageFile("testbuffer.bin"));
+      createDummyPages(bm, 8);
+      initPoolOptions(&opts);
+      opts.ioBackend = backend;
+      CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &opts));
+      CHECK(shutdownBufferPool(bm));
+      checkDummyPages(bm, 8);
+      CHECK(destroyPageFile("testbuffer.bin"));
+    }
+
+  free(bm);
+
+  TEST_DONE();
+}
+
+#define MISS_THREADS 8
+#define MISS_PAGES 16
+
+static void *
+pinAllPages (void *arg)
+{
+  BM_BufferPool *bm = (BM_BufferPool *) arg;
+  BM_PageHandle h;
+  char expected[32];
+  long bad = 0;
+  int i;
+
+  for (i = 0; i < MISS_PAGES; i++)
+    {
+      if (pinPage(bm, &h, i) != RC_OK)
+        return (void *) 1;
+      sprintf(expected, "%s-%i", "Page", i);
+      bad += strcmp(expected, h.data) != 0;
+      unpinPage(bm, &h);
+    }
+  return (void *) bad;
+}
+
+// threads missing on the same pages share one read per page
+void
+testConcurrentMisses (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  pthread_t threads[MISS_THREADS];
+  void *bad;
+  int i;
+  testName = "Concurrent misses on the same pages";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, MISS_PAGES);
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", MISS_PAGES, RS_LRU, NULL));
+  for (i = 0; i < MISS_THREADS; i++)
+    pthread_create(&threads[i], NULL, pinAllPages, bm);
+  for (i = 0; i < MISS_THREADS; i++)
+    {
+      pthread_join(threads[i], &bad);
+      ASSERT_TRUE(bad == NULL, "every pinner saw the page content");
+    }
+  ASSERT_EQUALS_INT(MISS_PAGES, getNumReadIO(bm), "one read per page");
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+
+  TEST_DONE();
+}
+
+#define HIT_THREADS 8
+#define HIT_ROUNDS 20000
+
+typedef struct HitArgs {
+  BM_BufferPool *bm;
+  int id;
+} HitArgs;
+
+static void *
+pinResidentPages (void *arg)
+{
+  HitArgs *a = (HitArgs *) arg;
+  BM_PageHandle h[2];
+  char expected[32];
+  long bad = 0;
+  int i, k;
+
+  for (i = 0; i < HIT_ROUNDS; i++)
+    {
+      // two overlapping pins at a time, on pages every other thread uses too
+      for (k = 0; k < 2; k++)
+        {
+          if (pinPage(a->bm, &h[k], (i * 7 + a->id + k * 5) % MISS_PAGES) != RC_OK)
+            return (void *) 1;
+          sprintf(expected, "%s-%i", "Page", h[k].pageNum);
+          bad += strcmp(expected, h[k].data) != 0;
+        }
+      for (k = 0; k < 2; k++)
+        bad += unpinPage(a->bm, &h[k]) != RC_OK;
+    }
+  return (void *) bad;
+}
+
+// threads pinning and unpinning the same resident pages through the partitioned hit path leave every fix count at 0
+void
+testConcurrentHits (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  pthread_t threads[HIT_THREADS];
+  HitArgs args[HIT_THREADS];
+  char expected[32];
+  int *fixCounts;
+  void *bad;
+  int i;
+  testName = "Concurrent hits on resident pages";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, MISS_PAGES);
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", MISS_PAGES, RS_LRU, NULL));
+  for (i = 0; i < MISS_PAGES; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      CHECK(unpinPage(bm, h));
+    }
+  for (i = 0; i < HIT_THREADS; i++)
+    {
+      args[i].bm = bm;
+      args[i].id = i;
+      pthread_create(&threads[i], NULL, pinResidentPages, &args[i]);
+    }
+  for (i = 0; i < HIT_THREADS; i++)
+    {
+      pthread_join(threads[i], &bad);
+      ASSERT_TRUE(bad == NULL, "every pin hit and saw the page content");
+    }
+  ASSERT_EQUALS_INT(MISS_PAGES, getNumReadIO(bm), "no page was read again");
+  fixCounts = getFixCounts(bm);
+  for (i = 0; i < MISS_PAGES; i++)
+    ASSERT_EQUALS_INT(0, fixCounts[i], "fix count back to 0");
+  for (i = 0; i < MISS_PAGES; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "page content intact");
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+static void
+pinAndCheck (BM_BufferPool *bm, BM_PageHandle *h, int pageNum)
+{
+  char expected[32];
+
+  CHECK(pinPage(bm, h, pageNum));
+  sprintf(expected, "%s-%i", "Page", pageNum);
+  ASSERT_EQUALS_STRING(expected, h->data, "reading back dummy page content");
+  CHECK(unpinPage(bm, h));
+}
+
+// prefetched pages are read once, and a read-ahead scan does not evict the pages used before it
+void
+testReadAhead (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions opts;
+  PageNumber *frames;
+  struct timespec tick = { 0, 1000 * 1000 };
+  int *fix;
+  int i, j, found, pinnedFrames;
+  testName = "Read-ahead and prefetching";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 100);
+
+  // explicit prefetch; pages past the end are skipped
+  CHECK(initBufferPool(bm, "testbuffer.bin", 20, RS_LRU, NULL));
+  CHECK(prefetchPages(bm, 95, 10));
+  for (i = 95; i < 100; i++)
+    pinAndCheck(bm, h, i);
+  ASSERT_EQUALS_INT(5, getNumReadIO(bm), "each prefetched page read once");
+  ASSERT_TRUE(prefetchPages(bm, -1, 1) != RC_OK, "negative start is rejected");
+
+  // with only a few hits after it, nothing takes the pool latch: the reads' completions release their pins themselves
+  CHECK(prefetchPages(bm, 80, 10));
+  for (i = 95; i < 100; i++)
+    pinAndCheck(bm, h, i);
+  for (j = 0, pinnedFrames = 1; j < 1000 && pinnedFrames > 0; j++)
+    {
+      nanosleep(&tick, NULL);
+      fix = getFixCounts(bm);
+      for (i = 0, pinnedFrames = 0; i < 20; i++)
+        pinnedFrames += fix[i] > 0;
+    }
+  ASSERT_EQUALS_INT(0, pinnedFrames, "prefetched frames unpinned without a miss");
+  ASSERT_EQUALS_INT(15, getNumReadIO(bm), "only the prefetched pages read");
+  CHECK(shutdownBufferPool(bm));
+
+  // a hot set, then a sequential scan with read-ahead
+  initPoolOptions(&opts);
+  opts.readAhead = 8;
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 20, RS_LRU, NULL, &opts));
+  for (j = 0; j < 2; j++)
+    for (i = 0; i < 10; i += 2)
+      pinAndCheck(bm, h, i);
+  for (i = 10; i < 100; i++)
+    pinAndCheck(bm, h, i);
+  ASSERT_EQUALS_INT(95, getNumReadIO(bm), "every page read exactly once");
+  frames = getFrameContents(bm);
+  for (i = 0; i < 10; i += 2)
+    {
+      for (j = 0, found = 0; j < 20; j++)
+        found |= (frames[j] == i);
+      ASSERT_TRUE(found, "hot page survives the scan");
+    }
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+// runs of pages to and from separate buffers, longer than one preadv/pwritev
+void
+testVectoredIO (void)
+{
+  SM_FileHandle fh;
+  SM_PageHandle bufs[300];
+  char expected[32];
+  int i;
+  testName = "Vectored multi-page reads and writes";
+
+  for (i = 0; i < 300; i++)
+    bufs[i] = (SM_PageHandle) malloc(PAGE_SIZE);
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  CHECK(ensureCapacity(310, &fh));
+
+  for (i = 0; i < 300; i++)
+    sprintf(bufs[i], "%s-%i", "Page", 10 + i);
+  CHECK(writeBlocks(10, 300, &fh, bufs));
+  ASSERT_EQUALS_INT(309, getBlockPos(&fh), "position at the last page written");
+  for (i = 0; i < 300; i++)
+    memset(bufs[i], 0, PAGE_SIZE);
+
+  CHECK(readBlocks(10, 300, &fh, bufs));
+  for (i = 0; i < 300; i++)
+    {
+      sprintf(expected, "%s-%i", "Page", 10 + i);
+      ASSERT_EQUALS_STRING(expected, bufs[i], "page of the run read back");
+    }
+  CHECK(readBlock(200, &fh, bufs[0]));
+  ASSERT_EQUALS_STRING("Page-200", bufs[0], "single page read of the run");
+
+  CHECK(readBlocks(0, 0, &fh, bufs));
+  ASSERT_TRUE(readBlocks(300, 11, &fh, bufs) == RC_READ_NON_EXISTING_PAGE, "run past the end cannot be read");
+  ASSERT_TRUE(writeBlocks(-1, 2, &fh, bufs) == RC_WRITE_FAILED, "negative page cannot be written");
+
+  CHECK(closePageFile(&fh));
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  for (i = 0; i < 300; i++)
+    free(bufs[i]);
+
+  TEST_DONE();
+}
+
+// dirty pages in scattered frames are all written by a pool flush; pinned ones wait for the next
+void
+testFlushRuns (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  SM_FileHandle fh;
+  char page[PAGE_SIZE];
+  char expected[32];
+  int order[] = { 12, 3, 7, 4, 5, 6, 11, 10, 2, 30 };
+  int i;
+  testName = "Sorted, coalesced pool flushes";
+
+  CHECK(createPageFile("testbuffer.bin"));
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", 20, RS_FIFO, NULL));
+  for (i = 0; i < 10; i++)
+    {
+      CHECK(pinPage(bm, h, order[i]));
+      sprintf(h->data, "%s-%i", "Page", order[i]);
+      CHECK(markDirty(bm, h));
+      if (order[i] != 30)
+        CHECK(unpinPage(bm, h));
+    }
+  h->pageNum = 5;
+  CHECK(forcePage(bm, h));
+  h->pageNum = 30;
+  ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "forced page written");
+  CHECK(forceFlushPool(bm));
+  ASSERT_EQUALS_INT(9, getNumWriteIO(bm), "every other unpinned dirty page written once");
+  ASSERT_TRUE(getDirtyFlags(bm)[9], "pinned page (frame 9) still dirty");
+  CHECK(unpinPage(bm, h));
+  CHECK(forceFlushPool(bm));
+  ASSERT_EQUALS_INT(10, getNumWriteIO(bm), "released page written");
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  for (i = 0; i < 10; i++)
+    {
+      CHECK(readBlock(order[i], &fh, page));
+      sprintf(expected, "%s-%i", "Page", order[i]);
+      ASSERT_EQUALS_STRING(expected, page, "flushed page content");
+    }
+  CHECK(closePageFile(&fh));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+// wait up to 5s for the pool to have written n pages
+static int
+waitForWrites (BM_BufferPool *bm, int n)
+{
+  struct timespec tick = { 0, 10 * 1000 * 1000 };
+  int i;
+
+  for (i = 0; i < 500 && getNumWriteIO(bm) < n; i++)
+    nanosleep(&tick, NULL);
+  return getNumWriteIO(bm);
+}
+
+// the background writer cleans unpinned dirty frames without a flush, at any rate limit
+void
+testBackgroundWriter (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions opts;
+  bool *dirty;
+  int i, rate;
+  testName = "Background writer";
+
+  for (rate = 0; rate <= 100; rate += 100)
+    {
+      CHECK(createPageFile("testbuffer.bin"));
+      initPoolOptions(&opts);
+      opts.bgCleanTarget = 10;
+      opts.bgMaxRate = rate;
+      CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 10, RS_LRU, NULL, &opts));
+      for (i = 0; i < 10; i++)
+        {
+          CHECK(pinPage(bm, h, i));
+          sprintf(h->data, "%s-%i", "Page", i);
+          CHECK(markDirty(bm, h));
+          if (i != 9)
+            CHECK(unpinPage(bm, h));
+        }
+
+      ASSERT_EQUALS_INT(9, waitForWrites(bm, 9), "unpinned dirty pages written in the background");
+      dirty = getDirtyFlags(bm);
+      for (i = 0; i < 9; i++)
+        ASSERT_TRUE(!dirty[i], "written page is clean");
+      ASSERT_TRUE(dirty[9], "pinned page left alone");
+      CHECK(unpinPage(bm, h));
+      ASSERT_EQUALS_INT(10, waitForWrites(bm, 10), "released page written too");
+
+      CHECK(shutdownBufferPool(bm));
+      checkDummyPages(bm, 10);
+      CHECK(destroyPageFile("testbuffer.bin"));
+    }
+
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+static long
+fileSize (const char *name)
+{
+  struct stat st;
+  return (stat(name, &st) == 0) ? (long) st.st_size : -1;
+}
+
+// records reach the log in one group commit, a restart replays them, and a page is written only after its records
+void
+testWriteAheadLog (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions opts;
+  WAL *w;
+  LSN lsn = 0;
+  long long records, syncs;
+  char expected[64];
+  long empty;
+  int i;
+  testName = "Write-ahead log";
+
+  remove("testbuffer.log");
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 10);
+
+  // log 100 changes, commit them together, then "crash": the page file never sees them
+  CHECK(wal_open(&w, "testbuffer.log"));
+  for (i = 0; i < 100; i++)
+    {
+      sprintf(expected, "%s-%i", "Logged", i);
+      CHECK(wal_append(w, i % 10, 0, strlen(expected) + 1, expected, &lsn));
+    }
+  ASSERT_TRUE(wal_flushedLSN(w) < lsn, "appending does not write the log");
+  CHECK(wal_flush(w, lsn));
+  ASSERT_TRUE(wal_flushedLSN(w) >= lsn, "log durable through the last record");
+  wal_counters(w, &records, &syncs);
+  ASSERT_EQUALS_INT(100, (int) records, "records appended");
+  ASSERT_EQUALS_INT(1, (int) syncs, "one sync for the whole batch");
+  wal_close(w);
+
+  // the pool replays the log at init
+  initPoolOptions(&opts);
+  opts.walFile = "testbuffer.log";
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_LRU, NULL, &opts));
+  for (i = 0; i < 10; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", "Logged", 90 + i);
+      ASSERT_EQUALS_STRING(expected, h->data, "page recovered from the log");
+      CHECK(unpinPage(bm, h));
+    }
+  empty = fileSize("testbuffer.log");
+
+  // a logged change is in the log before its page is written; a delta only covers its bytes
+  CHECK(pinPage(bm, h, 2));
+  sprintf(h->data, "%s-%i", "Changed", 2);
+  CHECK(logPageImage(bm, h, &lsn));
+  CHECK(unpinPage(bm, h));
+  ASSERT_TRUE(fileSize("testbuffer.log") == empty, "log not written yet");
+  CHECK(forcePage(bm, h));
+  ASSERT_TRUE(fileSize("testbuffer.log") > empty, "page write flushed the log first");
+  CHECK(pinPage(bm, h, 3));
+  memcpy(h->data, "Delta", 5);
+  CHECK(logPageUpdate(bm, h, 0, 5, NULL));
+  CHECK(unpinPage(bm, h));
+  ASSERT_ERROR(logPageUpdate(bm, h, PAGE_SIZE - 1, 2, NULL), "record past the end of the page");
+  CHECK(flushLog(bm, LSN_MAX));
+  CHECK(shutdownBufferPool(bm));
+  ASSERT_TRUE(fileSize("testbuffer.log") == empty, "clean shutdown empties the log");
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, 2));
+  ASSERT_EQUALS_STRING("Changed-2", h->data, "logged page written back");
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 3));
+  ASSERT_EQUALS_STRING("Deltad-93", h->data, "delta applied over the old content");
+  CHECK(unpinPage(bm, h));
+  ASSERT_ERROR(logPageImage(bm, h, NULL), "pool without a log");
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+  remove("testbuffer.log");
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+// a page torn by a crash during its home write is repaired from the double-write area at init
+void
+testDoubleWrite (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions opts;
+  BM_PoolStats st;
+  SM_FileHandle fh;
+  DoubleWrite *dw;
+  SM_PageHandle pages[4];
+  int pageNums[4] = { 3, 4, 5, 9 };
+  char expected[64];
+  int i;
+  testName = "Double-write area";
+
+  remove("testbuffer.dbl");
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 10);
+
+  // write a batch through the area, then tear one of its pages as a crash in the home write would
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  CHECK(dw_open(&dw, "testbuffer.dbl"));
+  for (i = 0; i < 4; i++)
+    {
+      pages[i] = calloc(PAGE_SIZE, 1);
+      sprintf(pages[i], "%s-%i", "Safe", pageNums[i]);
+    }
+  CHECK(dw_write(dw, &fh, pageNums, pages, 4));
+  dw_close(dw);
+  memset(pages[1] + PAGE_SIZE / 2, 'x', PAGE_SIZE / 2);
+  CHECK(writeBlock(4, &fh, pages[1]));
+  CHECK(closePageFile(&fh));
+
+  initPoolOptions(&opts);
+  opts.doubleWriteFile = "testbuffer.dbl";
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_FIFO, NULL, &opts));
+  ASSERT_EQUALS_INT(0, (int) fileSize("testbuffer.dbl"), "area emptied after recovery");
+  for (i = 0; i < 10; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(expected, "%s-%i", (i == 3 || i == 4 || i == 5 || i == 9) ? "Safe" : "Page", i);
+      ASSERT_EQUALS_STRING(expected, h->data, "page content after recovery");
+      if (i == 4)
+        ASSERT_TRUE(h->data[PAGE_SIZE - 1] == 0, "torn half restored");
+      CHECK(unpinPage(bm, h));
+    }
+
+  // write-backs go through the area: a flush batch leaves its pages there until shutdown
+  for (i = 0; i < 3; i++)
+    {
+      CHECK(pinPage(bm, h, 2 * i));
+      sprintf(h->data, "%s-%i", "Page", i);
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(forceFlushPool(bm));
+  ASSERT_EQUALS_INT(3, getNumWriteIO(bm), "pages written home");
+  ASSERT_EQUALS_INT(4 * PAGE_SIZE, (int) fileSize("testbuffer.dbl"), "one batch: header and three pages");
+
+  // a dirty victim takes the other dirty eviction candidates into its batch, so later evictions write nothing
+  for (i = 0; i < 3; i++)
+    {
+      CHECK(pinPage(bm, h, 2 * i));
+      CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(pinPage(bm, h, 7));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(6, getNumWriteIO(bm), "victim written along with the other dirty pages");
+  ASSERT_EQUALS_INT(4 * PAGE_SIZE, (int) fileSize("testbuffer.dbl"), "in one batch");
+  CHECK(pinPage(bm, h, 8));
+  CHECK(unpinPage(bm, h));
+  ASSERT_EQUALS_INT(6, getNumWriteIO(bm), "next eviction is clean");
+  CHECK(getPoolStats(bm, &st));
+  ASSERT_EQUALS_INT(1, (int) st.dirtyEvictions, "one dirty eviction");
+  ASSERT_EQUALS_INT(5, (int) st.flushes, "the pages written ahead of eviction are flushes");
+  CHECK(shutdownBufferPool(bm));
+  ASSERT_EQUALS_INT(0, (int) fileSize("testbuffer.dbl"), "clean shutdown empties the area");
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, 4));
+  ASSERT_EQUALS_STRING("Page-2", h->data, "flushed page written home");
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+  remove("testbuffer.dbl");
+  for (i = 0; i < 4; i++)
+    free(pages[i]);
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+static void
+copyFile (const char *from, const char *to)
+{
+  char buf[4096];
+  size_t n;
+  FILE *in = fopen(from, "rb"), *out = fopen(to, "wb");
+  while (in && out && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+    fwrite(buf, 1, n, out);
+  if (in) fclose(in);
+  if (out) fclose(out);
+}
+
+// a checkpoint writes the dirty pages, pinned ones too, and recovery replays only what was logged after it
+void
+testFuzzyCheckpoint (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+  BM_PoolOptions opts;
+  SM_FileHandle fh;
+  WAL *w;
+  bool *dirty;
+  int i, round, applied;
+  long maxLog = 0;
+  char *raw = malloc(PAGE_SIZE);
+  testName = "Fuzzy checkpoint";
+
+  remove("testbuffer.log");
+  remove("testbuffer.ckpt");
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 10);
+
+  initPoolOptions(&opts);
+  opts.walFile = "testbuffer.log";
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 5, RS_LRU, NULL, &opts));
+  for (i = 0; i < 4; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      sprintf(h->data, "%s-%i", "Checkpointed", i);
+      CHECK(logPageImage(bm, h, NULL));
+      CHECK(unpinPage(bm, h));
+    }
+  CHECK(pinPage(bm, pinned, 0));
+
+  // page 0 stays pinned across the checkpoint: it may hold a change not logged yet, so it is left to the log
+  CHECK(checkpointPool(bm));
+  ASSERT_EQUALS_INT(3, getNumWriteIO(bm), "every unpinned dirty page written");
+  dirty = getDirtyFlags(bm);
+  for (i = 0; i < 5; i++)
+    ASSERT_TRUE(dirty[i] == (i == 0), "only the pinned page dirty after the checkpoint");
+  CHECK(unpinPage(bm, pinned));
+
+  // one change after the checkpoint; keep the log as a crash would leave it
+  CHECK(pinPage(bm, h, 5));
+  sprintf(h->data, "%s-%i", "After", 5);
+  CHECK(logPageImage(bm, h, NULL));
+  CHECK(unpinPage(bm, h));
+  CHECK(flushLog(bm, LSN_MAX));
+  copyFile("testbuffer.log", "testbuffer.ckpt");
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(wal_open(&w, "testbuffer.ckpt"));
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  CHECK(wal_replay(w, &fh, &applied));
+  ASSERT_EQUALS_INT(5, applied, "replay starts at the first change of the skipped page");
+  CHECK(closePageFile(&fh));
+  wal_close(w);
+
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, 0));
+  ASSERT_EQUALS_STRING("Checkpointed-0", h->data, "skipped page recovered");
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 5));
+  ASSERT_EQUALS_STRING("After-5", h->data, "change after the checkpoint replayed");
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  // every checkpoint drops the log before it: 50 rounds of changes never leave more than one round in the log
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 5, RS_LRU, NULL, &opts));
+  for (round = 0; round < 50; round++)
+    {
+      for (i = 0; i < 4; i++)
+        {
+          CHECK(pinPage(bm, h, i));
+          sprintf(h->data, "%s-%i", "Round", round);
+          CHECK(logPageImage(bm, h, NULL));
+          CHECK(unpinPage(bm, h));
+        }
+      CHECK(checkpointPool(bm));
+      if (fileSize("testbuffer.log") > maxLog)
+        maxLog = fileSize("testbuffer.log");
+    }
+  ASSERT_TRUE(maxLog < 4 * PAGE_SIZE, "log bounded across checkpoints");
+  CHECK(pinPage(bm, h, 6));
+  sprintf(h->data, "%s-%i", "After", 6);
+  CHECK(logPageImage(bm, h, NULL));
+  CHECK(unpinPage(bm, h));
+  CHECK(flushLog(bm, LSN_MAX));
+  copyFile("testbuffer.log", "testbuffer.ckpt");
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(wal_open(&w, "testbuffer.ckpt"));
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  CHECK(wal_replay(w, &fh, &applied));
+  ASSERT_EQUALS_INT(1, applied, "shortened log replays from its last checkpoint");
+  CHECK(closePageFile(&fh));
+  wal_close(w);
+
+  // shutting down with a page still pinned: its logged change stays in the log, its unlogged one is lost
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 5, RS_LRU, NULL, &opts));
+  CHECK(pinPage(bm, pinned, 7));
+  sprintf(pinned->data, "%s-%i", "Pinned", 7);
+  CHECK(logPageImage(bm, pinned, NULL));
+  pinned->data[0] = 'X';
+  CHECK(shutdownBufferPool(bm));
+  CHECK(openPageFile("testbuffer.bin", &fh));
+  CHECK(readBlock(7, &fh, raw));
+  ASSERT_EQUALS_STRING("Page-7", raw, "page left pinned not written at shutdown");
+  CHECK(closePageFile(&fh));
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 5, RS_LRU, NULL, &opts));
+  CHECK(pinPage(bm, h, 7));
+  ASSERT_EQUALS_STRING("Pinned-7", h->data, "logged change of the pinned page redone at init");
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+  remove("testbuffer.log");
+  remove("testbuffer.ckpt");
+  free(bm);
+  free(h);
+  free(pinned);
+  free(raw);
+
+  TEST_DONE();
+}
+
+// pins, unpins and markDirty are recorded in order, and only when they succeed
+void
+testTraceRecorder (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_BufferPool *bm2 = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolOptions opts;
+  Trace *ta, *tb;
+  TraceEvent *ev;
+  long n;
+  int i;
+  const int pages[] = { 0, 1, 1, 0, 1, 2, 2 };
+  const TraceKind kinds[] = { TR_PIN, TR_PIN, TR_DIRTY, TR_UNPIN, TR_UNPIN, TR_PIN, TR_UNPIN };
+  testName = "Trace recorder";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  initPoolOptions(&opts);
+  opts.traceFile = "testbuffer.trace";
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_LRU, NULL, &opts));
+  CHECK(pinPage(bm, h, 0));
+  CHECK(pinPage(bm, h, 1));
+  CHECK(markDirty(bm, h));
+  h->pageNum = 0;
+  CHECK(unpinPage(bm, h));
+  h->pageNum = 1;
+  CHECK(unpinPage(bm, h));
+  ASSERT_ERROR(unpinPage(bm, &(BM_PageHandle) { .pageNum = 7 }), "unpin of a page not in the pool");
+  CHECK(pinPage(bm, h, 2));
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(trace_load("testbuffer.trace", &ev, &n));
+  ASSERT_EQUALS_INT(7, (int) n, "one event per successful call");
+  for (i = 0; i < 7 && i < n; i++)
+    {
+      ASSERT_EQUALS_INT(pages[i], ev[i].page, "event page");
+      ASSERT_EQUALS_INT(kinds[i], ev[i].kind, "event kind");
+      ASSERT_TRUE(i == 0 || ev[i].ns >= ev[i - 1].ns, "events in time order");
+    }
+  free(ev);
+
+  // a thread switching between traces keeps one buffer in each
+  CHECK(trace_open(&ta, "testbuffer.trace"));
+  CHECK(trace_open(&tb, "testbuffer2.trace"));
+  for (i = 0; i < 10000; i++)
+    {
+      trace_record(ta, TR_PIN, i);
+      trace_record(tb, TR_UNPIN, i);
+    }
+  ASSERT_EQUALS_INT(1, trace_numBuffers(ta), "one buffer in the first trace");
+  ASSERT_EQUALS_INT(1, trace_numBuffers(tb), "one buffer in the second trace");
+  trace_close(ta);
+  trace_close(tb);
+  CHECK(trace_load("testbuffer2.trace", &ev, &n));
+  ASSERT_EQUALS_INT(10000, (int) n, "every alternating event recorded");
+  ASSERT_TRUE(n == 10000 && ev[0].page == 0 && ev[9999].page == 9999 && ev[9999].kind == TR_UNPIN, "in order");
+  free(ev);
+
+  // the same with pins alternating between two traced pools
+  CHECK(initBufferPoolWithOptions(bm, "testbuffer.bin", 3, RS_LRU, NULL, &opts));
+  opts.traceFile = "testbuffer2.trace";
+  CHECK(initBufferPoolWithOptions(bm2, "testbuffer.bin", 3, RS_LRU, NULL, &opts));
+  for (i = 0; i < 5000; i++)
+    {
+      CHECK(pinPage(bm, h, i % 3));
+      CHECK(unpinPage(bm, h));
+      CHECK(pinPage(bm2, h, i % 3));
+      CHECK(unpinPage(bm2, h));
+    }
+  CHECK(shutdownBufferPool(bm));
+  CHECK(shutdownBufferPool(bm2));
+  CHECK(trace_load("testbuffer.trace", &ev, &n));
+  ASSERT_EQUALS_INT(10000, (int) n, "first pool's events recorded");
+  free(ev);
+  CHECK(trace_load("testbuffer2.trace", &ev, &n));
+  ASSERT_EQUALS_INT(10000, (int) n, "second pool's events recorded");
+  free(ev);
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+  remove("testbuffer.trace");
+  remove("testbuffer2.trace");
+  free(bm);
+  free(bm2);
+  free(h);
+
+  TEST_DONE();
+}
+
+static long long
+bucketSum (const long long *hist)
+{
+  long long sum = 0;
+  int i;
+  for (i = 0; i < BM_LATENCY_BUCKETS; i++)
+    sum += hist[i];
+  return sum;
+}
+
+// hits, misses, evictions and writes are told apart, and every read and write lands in a latency bucket
+void
+testPoolStats (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  BM_PoolStats st;
+  int i;
+  testName = "Pool statistics";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  createDummyPages(bm, 10);
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+
+  // three misses fill the pool; page 1 is changed
+  for (i = 0; i < 3; i++)
+    {
+      CHECK(pinPage(bm, h, i));
+      if (i == 1)
+        CHECK(markDirty(bm, h));
+      CHECK(unpinPage(bm, h));
+    }
+  // a hit, then two misses evict page 0 (clean) and page 1 (written first)
+  CHECK(pinPage(bm, h, 0));
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 3));
+  CHECK(unpinPage(bm, h));
+  CHECK(pinPage(bm, h, 4));
+  CHECK(unpinPage(bm, h));
+  // a hit on page 2 and a forced write
+  CHECK(pinPage(bm, h, 2));
+  CHECK(markDirty(bm, h));
+  CHECK(forcePage(bm, h));
+  CHECK(unpinPage(bm, h));
+
+  CHECK(getPoolStats(bm, &st));
+  ASSERT_EQUALS_INT(2, (int) st.hits, "hits");
+  ASSERT_EQUALS_INT(5, (int) st.misses, "misses");
+  ASSERT_EQUALS_INT(1, (int) st.cleanEvictions, "clean evictions");
+  ASSERT_EQUALS_INT(1, (int) st.dirtyEvictions, "dirty evictions");
+  ASSERT_EQUALS_INT(1, (int) st.flushes, "pages written ahead of eviction");
+  ASSERT_EQUALS_INT(getNumReadIO(bm), (int) st.reads, "reads match getNumReadIO");
+  ASSERT_EQUALS_INT(2, (int) st.writes, "writes");
+  ASSERT_TRUE(st.victimSteps >= 2, "victim search steps counted");
+  ASSERT_EQUALS_INT(5, (int) bucketSum(st.readLatency), "one latency sample per read");
+  ASSERT_EQUALS_INT(2, (int) bucketSum(st.writeLatency), "one latency sample per write call");
+  ASSERT_ERROR(getPoolStats(bm, NULL), "no stats struct");
+
+  // a pool flush counts as a flush, not as an eviction
+  CHECK(pinPage(bm, h, 3));
+  CHECK(markDirty(bm, h));
+  CHECK(unpinPage(bm, h));
+  CHECK(forceFlushPool(bm));
+  CHECK(getPoolStats(bm, &st));
+  ASSERT_EQUALS_INT(2, (int) st.flushes, "flushed page counted");
+  ASSERT_EQUALS_INT(1, (int) st.dirtyEvictions, "no eviction counted");
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+// the spans of a miss are exported as Chrome trace JSON (an empty trace unless built with PROBES=1)
+void
+testProbeExport (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  char *json;
+  long size;
+  FILE *in;
+  testName = "Probe trace export";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+  CHECK(pinPage(bm, h, 0));
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+
+  CHECK(probe_dumpChromeTrace("testbuffer.json"));
+  size = fileSize("testbuffer.json");
+  ASSERT_TRUE(size > 0, "trace written");
+  json = calloc(size + 1, 1);
+  in = fopen("testbuffer.json", "r");
+  ASSERT_TRUE(in != NULL && fread(json, 1, size, in) == (size_t) size, "trace read back");
+  fclose(in);
+  ASSERT_TRUE(strncmp(json, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 39) == 0, "Chrome trace header");
+  ASSERT_TRUE(strstr(json, "]}") != NULL, "event list closed");
+#ifdef BM_PROBES
+  ASSERT_TRUE(strstr(json, "\"name\":\"pin\"") != NULL, "pin span recorded");
+  ASSERT_TRUE(strstr(json, "\"name\":\"read\"") != NULL, "read span recorded");
+#endif
+  ASSERT_ERROR(probe_dumpChromeTrace(NULL), "no file name");
+  free(json);
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+  remove("testbuffer.json");
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
+#define ERR_THREADS 4
+#define ERR_ROUNDS 1000
+
+typedef struct ErrArgs {
+  BM_BufferPool *bm;
+  int page;
+} ErrArgs;
+
+static void *
+pinIntoFullPool (void *arg)
+{
+  ErrArgs *a = (ErrArgs *) arg;
+  BM_PageHandle h;
+  const RC_Error *e;
+  long bad = 0;
+  int i;
+
+  for (i = 0; i < ERR_ROUNDS; i++)
+    {
+      if (pinPage(a->bm, &h, a->page) != RC_WRITE_FAILED)
+        return (void *) 1;
+      e = lastError();
+      bad += e->rc != RC_WRITE_FAILED || e->pageNum != a->page || e->pool != a->bm
+        || e->message == NULL || strstr(e->message, "all pinned") == NULL || RC_message != e->message;
+    }
+  return (void *) bad;
+}
+
+// each thread sees its own last error, with the page and pool it concerned
+void
+testThreadLocalErrors (void)
+{
+  BM_BufferPool *bm = MAKE_POOL();
+  BM_PageHandle *h = MAKE_PAGE_HANDLE();
+  pthread_t threads[ERR_THREADS];
+  ErrArgs args[ERR_THREADS];
+  BM_PoolOptions opts;
+  void *bad;
+  int i;
+  testName = "Thread-local error records";
+
+  CHECK(createPageFile("testbuffer.bin"));
+  CHECK(initBufferPool(bm, "testbuffer.bin", 1, RS_FIFO, NULL));
+  CHECK(pinPage(bm, h, 0));
+
+  clearError();
+  for (i = 0; i < ERR_THREADS; i++)
+    {
+      args[i].bm = bm;
+      args[i].page = 10 + i;
+      pthread_create(&threads[i], NULL, pinIntoFullPool, &args[i]);
+    }
+  for (i = 0; i < ERR_THREADS; i++)
+    {
+      pthread_join(threads[i], &bad);
+      ASSERT_TRUE(bad == NULL, "every failed pin reported its own page and pool");
+    }
+  ASSERT_EQUALS_INT(RC_OK, lastError()->rc, "other threads' errors are not seen here");
+  ASSERT_TRUE(lastError()->message == NULL && lastError()->pageNum == NO_PAGE, "error record still clear");
+
+  ASSERT_ERROR(pinPage(bm, h, -3), "negative page number");
+  ASSERT_EQUALS_INT(RC_READ_NON_EXISTING_PAGE, lastError()->rc, "own error recorded");
+  ASSERT_EQUALS_INT(-3, lastError()->pageNum, "page of the failed pin");
+  ASSERT_TRUE(lastError()->pool == bm, "pool of the failed pin");
+  h->pageNum = 0;
+  CHECK(unpinPage(bm, h));
+  CHECK(shutdownBufferPool(bm));
+  ASSERT_ERROR(shutdownBufferPool(bm), "pool already shut down");
+  ASSERT_TRUE(lastError()->pageNum == NO_PAGE && lastError()->pool == bm, "pool-level error has no page");
+
+  // an error from a lower layer replaces the stale record too
+  initPoolOptions(&opts);
+  ASSERT_ERROR(pinPage(bm, h, -4), "stale error");
+  ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, initBufferPoolWithOptions(bm, "nosuchfile.bin", 3, RS_LRU, NULL, &opts), "missing page file");
+  ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, lastError()->rc, "storage error recorded");
+  ASSERT_TRUE(lastError()->pageNum == NO_PAGE && lastError()->pool == bm, "init error has the pool and no page");
+  ASSERT_TRUE(lastError()->message != NULL && RC_message == lastError()->message, "message set");
+
+  CHECK(destroyPageFile("testbuffer.bin"));
+  free(bm);
+  free(h);
+
+  TEST_DONE();
+}
+
 void
 testFIFO ()
 {
@@ -32,6 +32,10 @@ free(real);                                \
 static void createDummyPages(BM_BufferPool *bm, int num);
 
 static void testLRU_K (void);
+static void testLRU_K2 (void);
+static void testLFU (void);
+static void test2Q (void);
+static void testARC (void);
 
 static void testError (void);
 
@@ -43,6 +47,10 @@ main (void)
     testName = "";
     
     testLRU_K();
+    testLRU_K2();
+    testLFU();
+    test2Q();
+    testARC();
     testError();
     return 0;
 }
@@ -143,6 +151,231 @@ testLRU_K (void)
     TEST_DONE();
 }
 
+// test LRU_K with K=2: a one-off scan must not push out pages referenced twice,
+// and a page evicted earlier keeps its history when it comes back
+void
+testLRU_K2 (void)
+{
+    // expected results
+    const char *poolContents[] = {
+        // reference pages 0 and 1 twice each
+        "[0 0],[1 0],[-1 0]",
+        // scan pages 2-4 once: they only replace each other
+        "[0 0],[1 0],[2 0]",
+        "[0 0],[1 0],[3 0]",
+        "[0 0],[1 0],[4 0]",
+        // page 2 returns with its retained history and now has two references
+        "[0 0],[1 0],[2 0]",
+        // oldest second-to-last reference is page 0's
+        "[6 0],[1 0],[2 0]"
+    };
+    const int hotRequests[] = {0,1,0,1};
+    const int scanRequests[] = {2,3,4,2,6};
+    
+    int i;
+    int k = 2;
+    int snapshot = 0;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing LRU_K page replacement with K=2";
+    
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 100);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU_K, &k));
+    
+    for(i = 0; i < 4; i++)
+    {
+        pinPage(bm, h, hotRequests[i]);
+        unpinPage(bm, h);
+    }
+    ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content after hot pages");
+    
+    for(i = 0; i < 5; i++)
+    {
+        pinPage(bm, h, scanRequests[i]);
+        unpinPage(bm, h);
+        ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content during scan");
+    }
+    
+    // check number of write IOs
+    ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+    ASSERT_EQUALS_INT(7, getNumReadIO(bm), "check number of read I/Os");
+    
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void
+testLFU (void)
+{
+    // expected results
+    const char *poolContents[] = {
+        // page 0 referenced three times, page 1 twice, page 2 once
+        "[0 0],[1 0],[2 0]",
+        // least frequently used page 2 goes; page 3 starts at its priority + 1
+        "[0 0],[1 0],[3 0]",
+        // pages 1 and 3 tie, page 1 was referenced longer ago
+        "[0 0],[4 0],[3 0]",
+        "[0 0],[4 0],[5 0]",
+        // aging has caught up with page 0's old popularity
+        "[6 0],[4 0],[5 0]"
+    };
+    const int hotRequests[] = {0,0,0,1,1,2};
+    const int newRequests[] = {3,4,5,6};
+    
+    int i;
+    int snapshot = 0;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing LFU page replacement";
+    
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 100);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LFU, NULL));
+    
+    for(i = 0; i < 6; i++)
+    {
+        pinPage(bm, h, hotRequests[i]);
+        unpinPage(bm, h);
+    }
+    ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content after hot pages");
+    
+    for(i = 0; i < 4; i++)
+    {
+        pinPage(bm, h, newRequests[i]);
+        unpinPage(bm, h);
+        ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+    }
+    
+    // check number of write IOs
+    ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+    ASSERT_EQUALS_INT(7, getNumReadIO(bm), "check number of read I/Os");
+    
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void
+test2Q (void)
+{
+    // expected results
+    const char *poolContents[] = {
+        // pages 0-3 enter A1in, page 0 is hit there
+        "[0 0],[1 0],[2 0],[3 0]",
+        // A1in holds more than a quarter of the pool: its oldest page 0 goes to A1out
+        "[4 0],[1 0],[2 0],[3 0]",
+        // pages 0 and 1 return while remembered in A1out and move to Am
+        "[4 0],[0 0],[2 0],[3 0]",
+        "[4 0],[0 0],[1 0],[3 0]",
+        // a scan only cycles through A1in
+        "[4 0],[0 0],[1 0],[5 0]",
+        "[6 0],[0 0],[1 0],[5 0]",
+        "[6 0],[0 0],[1 0],[7 0]"
+    };
+    const int hotRequests[] = {0,1,2,3,0};
+    const int requests[] = {4,0,1,5,6,7};
+    
+    int i;
+    int snapshot = 0;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing 2Q page replacement";
+    
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 100);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_2Q, NULL));
+    
+    for(i = 0; i < 5; i++)
+    {
+        pinPage(bm, h, hotRequests[i]);
+        unpinPage(bm, h);
+    }
+    ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content after first references");
+    
+    for(i = 0; i < 6; i++)
+    {
+        pinPage(bm, h, requests[i]);
+        unpinPage(bm, h);
+        ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+    }
+    
+    // check number of write IOs
+    ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+    ASSERT_EQUALS_INT(10, getNumReadIO(bm), "check number of read I/Os");
+    
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void
+testARC (void)
+{
+    // expected results
+    const char *poolContents[] = {
+        // pages 0 and 1 are referenced twice (T2), pages 2 and 3 once (T1)
+        "[0 0],[1 0],[2 0],[3 0]",
+        // T1 is above its target size 0: page 2 goes to B1
+        "[0 0],[1 0],[4 0],[3 0]",
+        // page 2 returns from B1: the T1 target grows to 1, page 3 goes to B1
+        "[0 0],[1 0],[4 0],[2 0]",
+        // T1 is at its target, so the LRU page of T2 is evicted to B2
+        "[5 0],[1 0],[4 0],[2 0]",
+        // the rest of the scan replaces T1 pages
+        "[5 0],[1 0],[6 0],[2 0]",
+        "[7 0],[1 0],[6 0],[2 0]",
+        // page 0 returns from B2: the T1 target shrinks back to 0
+        "[7 0],[1 0],[0 0],[2 0]"
+    };
+    const int hotRequests[] = {0,1,2,3,0,1};
+    const int requests[] = {4,2,5,6,7,0};
+    
+    int i;
+    int snapshot = 0;
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing ARC page replacement";
+    
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 100);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_ARC, NULL));
+    
+    for(i = 0; i < 6; i++)
+    {
+        pinPage(bm, h, hotRequests[i]);
+        unpinPage(bm, h);
+    }
+    ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content after first references");
+    
+    for(i = 0; i < 6; i++)
+    {
+        pinPage(bm, h, requests[i]);
+        unpinPage(bm, h);
+        ASSERT_EQUALS_POOL(poolContents[snapshot++], bm, "check pool content using pages");
+    }
+    
+    // check number of write IOs
+    ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "check number of write I/Os");
+    ASSERT_EQUALS_INT(10, getNumReadIO(bm), "check number of read I/Os");
+    
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
 
 // test error cases
 void
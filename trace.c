@@ -0,0 +1,243 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+#include "dberror.h"
+
+/*
+ * Trace File
+ * ----------
+ * A 16-byte header (magic "BMT1", reserved word, CLOCK_REALTIME of the
+ * start in ns) followed by 12-byte records: the stamp (ns << 2 | kind) as
+ * two 32-bit halves, then the page number. Records of one thread appear in
+ * the order it made them; blocks of different threads interleave.
+ *
+ * A thread finds its buffer through a thread-local pointer tagged with the
+ * trace's id; ids are never reused, so a buffer left over from a closed
+ * trace is never mistaken for one of a newer trace at the same address.
+ * When the thread records into another trace, it looks its buffer in that
+ * trace up on the trace's list by owner, so a thread alternating between
+ * traces has one buffer in each instead of a new one per switch. The
+ * buffers stay on the trace's list until trace_close writes out and frees
+ * them, which also covers threads that exited while recording (a new
+ * thread that gets the same pthread_t carries on in the dead one's buffer).
+ */
+
+/* ------------ Internal structures ------------ */
+
+#define TRACE_MAGIC     0x31544D42u  /* "BMT1" */
+#define TRACE_BUF_EVENTS 4096        /* events per thread buffer */
+
+typedef struct TraceFileHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    int64_t  startRealtime;
+} TraceFileHeader;
+
+typedef struct TraceRecord {
+    uint32_t stampLo;
+    uint32_t stampHi;
+    int32_t  page;
+} TraceRecord;
+
+_Static_assert(sizeof(TraceRecord) == 12, "trace records are 12 bytes");
+
+typedef struct TraceBuf {
+    struct TraceBuf *next;
+    pthread_t        owner;
+    int              n;
+    TraceRecord      recs[TRACE_BUF_EVENTS];
+} TraceBuf;
+
+struct Trace {
+    int              fd;
+    long long        id;
+    struct timespec  start;
+    pthread_mutex_t  lock;    /* the file and the buffer list */
+    TraceBuf        *bufs;
+    int              numBufs;
+    bool             failed;  /* a write failed: later events are dropped (lock) */
+};
+
+static atomic_llong nextTraceId = 1;
+
+static _Thread_local struct {
+    long long  id;
+    TraceBuf  *buf;
+} mine;
+
+/* ------------ Helpers ------------ */
+
+static int write_all(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        ssize_t k = write(fd, p, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return 0;
+        p += k; n -= (size_t)k;
+    }
+    return 1;
+}
+
+static int read_all(int fd, char *p, size_t n) {
+    while (n > 0) {
+        ssize_t k = read(fd, p, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return 0;
+        p += k; n -= (size_t)k;
+    }
+    return 1;
+}
+
+/* append buf's records to the file and empty it; caller holds t->lock */
+static void spill_locked(Trace *t, TraceBuf *b) {
+    if (!t->failed && b->n > 0 && !write_all(t->fd, (const char *)b->recs, sizeof(TraceRecord) * (size_t)b->n))
+        t->failed = TRUE;
+    b->n = 0;
+}
+
+static TraceBuf *my_buffer(Trace *t) {
+    if (mine.id == t->id) return mine.buf;
+    pthread_t self = pthread_self();
+    TraceBuf *b;
+    pthread_mutex_lock(&t->lock);
+    for (b = t->bufs; b && !pthread_equal(b->owner, self); b = b->next);
+    if (!b && (b = malloc(sizeof(TraceBuf)))) {
+        b->n = 0;
+        b->owner = self;
+        b->next = t->bufs;
+        t->bufs = b;
+        t->numBufs++;
+    }
+    pthread_mutex_unlock(&t->lock);
+    if (!b) return NULL;
+    mine.id = t->id;
+    mine.buf = b;
+    return b;
+}
+
+typedef struct Indexed { TraceEvent ev; long seq; } Indexed;
+
+static int cmp_time(const void *a, const void *b) {
+    const Indexed *x = a, *y = b;
+    if (x->ev.ns != y->ev.ns) return (x->ev.ns > y->ev.ns) - (x->ev.ns < y->ev.ns);
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+/* ------------ Public API ------------ */
+
+RC trace_open(Trace **out, const char *fileName) {
+    if (!out || !fileName) return RC_FILE_HANDLE_NOT_INIT;
+    *out = NULL;
+
+    Trace *t = calloc(1, sizeof(Trace));
+    if (!t) return RC_WRITE_FAILED;
+    t->fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (t->fd < 0) {
+        free(t);
+        return RC_FILE_NOT_FOUND;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    TraceFileHeader h = { TRACE_MAGIC, 0, (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec };
+    if (!write_all(t->fd, (const char *)&h, sizeof(h))) {
+        close(t->fd);
+        free(t);
+        return RC_WRITE_FAILED;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t->start);
+    t->id = atomic_fetch_add(&nextTraceId, 1);
+    pthread_mutex_init(&t->lock, NULL);
+    *out = t;
+    return RC_OK;
+}
+
+void trace_close(Trace *t) {
+    if (!t) return;
+    pthread_mutex_lock(&t->lock);
+    for (TraceBuf *b = t->bufs, *next; b; b = next) {
+        next = b->next;
+        spill_locked(t, b);
+        free(b);
+    }
+    t->bufs = NULL;
+    pthread_mutex_unlock(&t->lock);
+    close(t->fd);
+    pthread_mutex_destroy(&t->lock);
+    free(t);
+}
+
+int trace_numBuffers(Trace *t) {
+    pthread_mutex_lock(&t->lock);
+    int n = t->numBufs;
+    pthread_mutex_unlock(&t->lock);
+    return n;
+}
+
+void trace_record(Trace *t, TraceKind kind, PageNumber page) {
+    TraceBuf *b = my_buffer(t);
+    if (!b) return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t ns = (uint64_t)((now.tv_sec - t->start.tv_sec) * 1000000000LL + (now.tv_nsec - t->start.tv_nsec));
+    uint64_t stamp = (ns << 2) | (uint64_t)kind;
+    TraceRecord *r = &b->recs[b->n++];
+    r->stampLo = (uint32_t)stamp;
+    r->stampHi = (uint32_t)(stamp >> 32);
+    r->page = page;
+    if (b->n == TRACE_BUF_EVENTS) {
+        pthread_mutex_lock(&t->lock);
+        spill_locked(t, b);
+        pthread_mutex_unlock(&t->lock);
+    }
+}
+
+RC trace_load(const char *fileName, TraceEvent **events, long *count) {
+    if (!fileName || !events || !count) return RC_FILE_HANDLE_NOT_INIT;
+    *events = NULL;
+    *count = 0;
+
+    int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return RC_FILE_NOT_FOUND;
+    TraceFileHeader h;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < (off_t)sizeof(h) || lseek(fd, 0, SEEK_SET) != 0 || !read_all(fd, (char *)&h, sizeof(h)) || h.magic != TRACE_MAGIC) {
+        close(fd);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+
+    /* a record cut short at the end (the recorder died mid-write) is ignored */
+    long n = (long)((size - (off_t)sizeof(h)) / (off_t)sizeof(TraceRecord));
+    TraceRecord *recs = malloc(sizeof(TraceRecord) * (size_t)(n > 0 ? n : 1));
+    Indexed *all = malloc(sizeof(Indexed) * (size_t)(n > 0 ? n : 1));
+    TraceEvent *out = malloc(sizeof(TraceEvent) * (size_t)(n > 0 ? n : 1));
+    if (!recs || !all || !out || !read_all(fd, (char *)recs, sizeof(TraceRecord) * (size_t)n)) {
+        RC rc = (!recs || !all || !out) ? RC_WRITE_FAILED : RC_READ_NON_EXISTING_PAGE;
+        free(recs); free(all); free(out);
+        close(fd);
+        return rc;
+    }
+    close(fd);
+
+    for (long i = 0; i < n; i++) {
+        uint64_t stamp = ((uint64_t)recs[i].stampHi << 32) | recs[i].stampLo;
+        all[i].ev.ns = (long long)(stamp >> 2);
+        all[i].ev.kind = (TraceKind)(stamp & 3);
+        all[i].ev.page = recs[i].page;
+        all[i].seq = i;
+    }
+    qsort(all, (size_t)n, sizeof(Indexed), cmp_time);
+    for (long i = 0; i < n; i++) out[i] = all[i].ev;
+    free(recs);
+    free(all);
+    *events = out;
+    *count = n;
+    return RC_OK;
+}
@@ -0,0 +1,45 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "buffer_mgr.h"
+
+/*
+ * Trace — a compact binary record of a pool's page references.
+ * ------------------------------------------------------------
+ * Every pin, unpin and markDirty is one 12-byte event: the page number and
+ * the time since the trace was opened, in nanoseconds, with the event kind
+ * packed into the low bits. Each recording thread fills a private buffer of
+ * its own and takes the trace's lock only to append a full buffer to the
+ * file, so recording costs a clock read and a store per event. Buffers are
+ * written out as they fill, so the file is ordered per thread but not
+ * overall; trace_load merges the events back into time order.
+ *
+ * trace_replay runs a trace against the replacement policies offline.
+ */
+
+typedef enum TraceKind {
+    TR_PIN = 0,
+    TR_UNPIN = 1,
+    TR_DIRTY = 2
+} TraceKind;
+
+typedef struct TraceEvent {
+    long long  ns;        /* since the trace was opened */
+    PageNumber page;
+    TraceKind  kind;
+} TraceEvent;
+
+typedef struct Trace Trace;
+
+/* create (or truncate) a trace file */
+RC   trace_open (Trace **t, const char *fileName);
+/* write out the events still buffered and close the file; no trace_record may run concurrently */
+void trace_close (Trace *t);
+void trace_record (Trace *t, TraceKind kind, PageNumber page);
+/* buffers allocated so far: one per thread that has recorded into t */
+int  trace_numBuffers (Trace *t);
+
+/* read a whole trace, in time order; *events is malloc'ed and owned by the caller */
+RC   trace_load (const char *fileName, TraceEvent **events, long *count);
+
+#endif
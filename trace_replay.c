@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "buffer_mgr.h"
+#include "page_table.h"
+#include "replacer.h"
+#include "trace.h"
+#include "dberror.h"
+
+/*
+ * Trace Replay
+ * ------------
+ * Runs a trace recorded with BM_PoolOptions.traceFile against replacement
+ * strategies and pool sizes and prints one CSV row per combination: pins,
+ * hits, hit ratio, misses, dirty evictions (page writes a real pool would
+ * make) and pins that found every frame pinned. No page file is involved:
+ * the simulated pool has the buffer manager's frame bookkeeping (page table,
+ * fix counts, dirty bits, free frames first) around the real replacer.
+ *
+ *   trace_replay [-s strategies] [-p poolSizes] [-k K] traceFile
+ *   trace_replay [-s strategies] [-p poolSizes] [-k K] [-z theta] -g lookups,pages,scans,scanPages
+ *
+ * Strategies and pool sizes are comma-separated lists; by default every
+ * strategy runs at 8, 16, 32, ... frames up to the number of distinct pages
+ * in the trace, i.e. a hit-ratio curve.
+ *
+ * -g replays a synthetic trace instead of a file: zipf(theta, default 0.99)
+ * lookups over pages [0, pages), hot pages first, interrupted `scans` times,
+ * evenly, by a sequential scan of the scanPages pages after them. Every
+ * reference is a pin and its unpin, and the random numbers come from a fixed
+ * seed, so a command line always yields the same trace
+ * (`make hit_ratios` prints the README table).
+ */
+
+/* ------------ Configuration ------------ */
+
+#define MAX_LIST 64
+
+static const char *stratNames[] = { "fifo", "lru", "clock", "lfu", "lru-k", "2q", "arc" };
+
+/* ------------ Synthetic trace ------------ */
+
+#define GEN_SEED 0x9E3779B97F4A7C15ULL
+
+static uint64_t next_rand(uint64_t *s) {   /* xorshift64* */
+    *s ^= *s >> 12; *s ^= *s << 25; *s ^= *s >> 27;
+    return *s * 2685821657736338717ULL;
+}
+
+/* page drawn from cdf, the cumulative zipf distribution over n pages */
+static int zipf_page(const double *cdf, int n, uint64_t *s) {
+    double u = (double)(next_rand(s) >> 11) / (double)(1ULL << 53);
+    int lo = 0, hi = n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cdf[mid] < u) lo = mid + 1; else hi = mid;
+    }
+    return lo;
+}
+
+static void reference(TraceEvent *ev, long *n, PageNumber page) {
+    ev[*n] = (TraceEvent){ .ns = *n, .page = page, .kind = TR_PIN };
+    (*n)++;
+    ev[*n] = (TraceEvent){ .ns = *n, .page = page, .kind = TR_UNPIN };
+    (*n)++;
+}
+
+/* spec is lookups,pages,scans,scanPages; scan j starts after lookup (j+1)*lookups/(scans+1) */
+static RC generate(const char *spec, double theta, TraceEvent **events, long *count) {
+    long lookups, scans;
+    int pages, scanPages;
+    if (sscanf(spec, "%ld,%d,%ld,%d", &lookups, &pages, &scans, &scanPages) != 4
+        || lookups < 0 || pages <= 0 || scans < 0 || scanPages < 0) return RC_FILE_HANDLE_NOT_INIT;
+
+    TraceEvent *ev = malloc(sizeof(TraceEvent) * (size_t)(2 * (lookups + scans * scanPages) + 1));
+    double *cdf = malloc(sizeof(double) * (size_t)pages);
+    if (!ev || !cdf) { free(ev); free(cdf); return RC_WRITE_FAILED; }
+    double sum = 0;
+    for (int i = 0; i < pages; i++) sum += 1.0 / pow(i + 1, theta);
+    for (int i = 0; i < pages; i++) cdf[i] = (i ? cdf[i - 1] : 0) + 1.0 / pow(i + 1, theta) / sum;
+    cdf[pages - 1] = 1.0;
+
+    uint64_t rng = GEN_SEED;
+    long n = 0, scan = 0;
+    for (long i = 0; i < lookups; i++) {
+        for (; scan < scans && i == (scan + 1) * lookups / (scans + 1); scan++)
+            for (int p = 0; p < scanPages; p++) reference(ev, &n, pages + p);
+        reference(ev, &n, zipf_page(cdf, pages, &rng));
+    }
+    for (; scan < scans; scan++)   /* no lookups to spread them over */
+        for (int p = 0; p < scanPages; p++) reference(ev, &n, pages + p);
+    free(cdf);
+    *events = ev;
+    *count = n;
+    return RC_OK;
+}
+
+/* ------------ Simulated pool ------------ */
+
+typedef struct SimResult {
+    long pins, hits, dirtyEvictions, failed;
+} SimResult;
+
+static RC simulate(const TraceEvent *ev, long n, ReplacementStrategy strategy, int frames, int k, SimResult *res) {
+    Replacer r;
+    PageTable map;
+    PageNumber *page = malloc(sizeof(PageNumber) * (size_t)frames);
+    int *fix = calloc((size_t)frames, sizeof(int));
+    bool *dirty = calloc((size_t)frames, sizeof(bool));
+    int used = 0;
+    RC rc;
+
+    memset(res, 0, sizeof(*res));
+    if (!page || !fix || !dirty) { free(page); free(fix); free(dirty); return RC_WRITE_FAILED; }
+    if ((rc = replacerInit(&r, strategy, frames, (strategy == RS_LRU_K) ? &k : NULL)) != RC_OK) {
+        free(page); free(fix); free(dirty);
+        return rc;
+    }
+    if ((rc = ptab_init(&map, frames)) != RC_OK) {
+        replacerFree(&r);
+        free(page); free(fix); free(dirty);
+        return rc;
+    }
+
+    for (long i = 0; i < n && rc == RC_OK; i++) {
+        long long tick = i + 1;
+        int f = ptab_get(&map, ev[i].page);
+        switch (ev[i].kind) {
+        case TR_PIN:
+            res->pins++;
+            if (f >= 0) {
+                res->hits++;
+                fix[f]++;
+                replacerAccess(&r, f, ev[i].page, tick);
+                break;
+            }
+            if (used < frames) f = used++;
+            else {
+                f = replacerVictim(&r, ev[i].page);
+                if (f < 0) { res->failed++; break; }
+                if (dirty[f]) res->dirtyEvictions++;
+                replacerRemove(&r, f);
+                ptab_del(&map, page[f]);
+            }
+            page[f] = ev[i].page;
+            fix[f] = 1;
+            dirty[f] = FALSE;
+            rc = ptab_put(&map, ev[i].page, f);
+            replacerLoad(&r, f, ev[i].page, tick);
+            break;
+        case TR_UNPIN:
+            /* pins the recorded pool granted but this smaller one refused have no frame to release */
+            if (f >= 0 && fix[f] > 0 && --fix[f] == 0) replacerUnpin(&r, f, ev[i].page, tick);
+            break;
+        case TR_DIRTY:
+            if (f >= 0) dirty[f] = TRUE;
+            break;
+        }
+    }
+
+    ptab_free(&map);
+    replacerFree(&r);
+    free(page);
+    free(fix);
+    free(dirty);
+    return rc;
+}
+
+/* ------------ Command line ------------ */
+
+static int parse_list(char *arg, int *out, int isStrategy) {
+    int n = 0;
+    for (char *tok = strtok(arg, ","); tok && n < MAX_LIST; tok = strtok(NULL, ",")) {
+        int v = -1;
+        if (isStrategy) {
+            for (int i = 0; i < 7; i++)
+                if (strcmp(tok, stratNames[i]) == 0) v = i;
+        } else if ((v = atoi(tok)) <= 0) v = -1;
+        if (v < 0) {
+            fprintf(stderr, "bad list entry: %s\n", tok);
+            exit(2);
+        }
+        out[n++] = v;
+    }
+    return n;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-s strategies] [-p poolSizes] [-k K] traceFile\n"
+                    "       %s [-s strategies] [-p poolSizes] [-k K] [-z theta] -g lookups,pages,scans,scanPages\n", prog, prog);
+    exit(2);
+}
+
+static int distinct_pages(const TraceEvent *ev, long n) {
+    PageTable seen;
+    int count = 0;
+    if (ptab_init(&seen, 1024) != RC_OK) return 0;
+    for (long i = 0; i < n; i++)
+        if (ev[i].kind == TR_PIN && ptab_get(&seen, ev[i].page) < 0 && ptab_put(&seen, ev[i].page, 0) == RC_OK) count++;
+    ptab_free(&seen);
+    return count;
+}
+
+int main(int argc, char **argv) {
+    int strats[MAX_LIST] = { 0, 1, 2, 3, 4, 5, 6 }, nStrats = 7;
+    int sizes[MAX_LIST], nSizes = 0;
+    int k = 2, opt;
+    const char *spec = NULL;
+    double theta = 0.99;
+
+    while ((opt = getopt(argc, argv, "s:p:k:g:z:")) != -1) {
+        switch (opt) {
+        case 's': nStrats = parse_list(optarg, strats, 1); break;
+        case 'p': nSizes = parse_list(optarg, sizes, 0); break;
+        case 'k': k = atoi(optarg); break;
+        case 'g': spec = optarg; break;
+        case 'z': theta = atof(optarg); break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - (spec ? 0 : 1) || k < 1) usage(argv[0]);
+
+    TraceEvent *ev;
+    long n;
+    RC rc = spec ? generate(spec, theta, &ev, &n) : trace_load(argv[optind], &ev, &n);
+    if (rc != RC_OK) {
+        fprintf(stderr, "cannot %s %s (RC %d)\n", spec ? "generate trace" : "read trace", spec ? spec : argv[optind], rc);
+        return 1;
+    }
+    if (nSizes == 0) {
+        int distinct = distinct_pages(ev, n);
+        for (int s = 8; nSizes < MAX_LIST; s *= 2) {
+            sizes[nSizes++] = s;
+            if (s >= distinct) break;
+        }
+    }
+
+    printf("strategy,pool,pins,hits,hit_ratio,misses,dirty_evictions,failed\n");
+    for (int a = 0; a < nStrats; a++) {
+        for (int b = 0; b < nSizes; b++) {
+            SimResult res;
+            if ((rc = simulate(ev, n, (ReplacementStrategy)strats[a], sizes[b], k, &res)) != RC_OK) {
+                fprintf(stderr, "%s with %d frames: RC %d\n", stratNames[strats[a]], sizes[b], rc);
+                continue;
+            }
+            long granted = res.pins - res.failed;
+            printf("%s,%d,%ld,%ld,%.4f,%ld,%ld,%ld\n", stratNames[strats[a]], sizes[b], res.pins, res.hits,
+                   res.pins ? (double)res.hits / (double)res.pins : 0.0, granted - res.hits, res.dirtyEvictions, res.failed);
+        }
+    }
+    free(ev);
+    return 0;
+}
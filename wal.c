@@ -0,0 +1,431 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "wal.h"
+#include "checksum.h"
+#include "dberror.h"
+
+/*
+ * Write-Ahead Log
+ * ---------------
+ * File layout: a WalFileHeader, then records back to back. Each record is a
+ * WalRecord followed by `length` payload bytes. The header's `base` is the
+ * LSN of the first byte after it, so LSNs keep growing when the log is
+ * emptied by wal_reset and a record at LSN x ends at file offset
+ * sizeof(WalFileHeader) + (x - base).
+ *
+ * A record's checksum is a CRC-32 of its payload followed by the rest of its
+ * header (LSN included), so the payload part is computed before taking the
+ * lock. Opening the log scans it up to the first record that is short, has
+ * a bad checksum or an unexpected LSN, and truncates the file there.
+ *
+ * A checkpoint record carries the redo LSN of a completed checkpoint: every
+ * change logged before it is in the page file, so replay starts there. The
+ * records before it are then dropped: the rest of the log is copied to a new
+ * file with base = redo, which is synced and renamed over the old one, so a
+ * crash leaves either complete log. The copy is made only once the prefix is
+ * at least as long as the rest, so it costs no more I/O than the records it
+ * reclaims, and the log stays within twice what was appended since the
+ * previous checkpoint began.
+ *
+ * Appends copy into the current one of two buffers under `lock`. A flush
+ * leader swaps the buffers, writes the full one without the lock and syncs,
+ * so appends continue into the other buffer while the sync runs and the next
+ * leader picks all of them up at once.
+ */
+
+/* ------------ Internal structures ------------ */
+
+#define WAL_MAGIC   0x314c4157u  /* "WAL1" */
+#define WAL_BUFFER  (1 << 20)    /* bytes per append buffer; holds at least one page image */
+
+enum { WAL_PAGE_IMAGE = 1, WAL_PAGE_DELTA = 2, WAL_CHECKPOINT = 3 };
+
+typedef struct WalFileHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    int64_t  base;
+} WalFileHeader;
+
+typedef struct WalRecord {
+    uint32_t crc;
+    uint32_t type;
+    int64_t  lsn;       /* end of this record */
+    int32_t  pageNum;
+    int32_t  offset;
+    int32_t  length;
+    int32_t  reserved;
+} WalRecord;
+
+struct WAL {
+    int             fd;
+    char           *name;
+    LSN             base;
+    LSN             redo;      /* of the last checkpoint record; replay starts here (or at base) */
+
+    pthread_mutex_t lock;      /* everything below */
+    pthread_cond_t  cond;      /* a flush finished */
+    char           *buf[2];
+    int             cur;       /* buffer taking appends */
+    size_t          used;
+    LSN             bufStart;  /* LSN of buf[cur][0] */
+    LSN             flushed;   /* durable through here */
+    int             flushing;  /* a leader is writing the other buffer, or the log is being copied */
+    int             failed;    /* a log write failed: the log is unusable */
+    long long       records;
+    long long       syncs;
+};
+
+/* ------------ Checksums ------------ */
+
+/* Checksum of a record given the CRC of its payload: everything in the header after the crc field */
+static uint32_t record_crc(uint32_t payloadCrc, const WalRecord *r) {
+    return crc32_update(payloadCrc, (const char *)r + sizeof(uint32_t), sizeof(WalRecord) - sizeof(uint32_t));
+}
+
+/* ------------ File helpers ------------ */
+
+static off_t file_offset(const WAL *w, LSN lsn) {
+    return (off_t)sizeof(WalFileHeader) + (off_t)(lsn - w->base);
+}
+
+static int write_all(int fd, const char *p, size_t n, off_t off) {
+    while (n > 0) {
+        ssize_t k = pwrite(fd, p, n, off);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return 0;
+        p += k; n -= (size_t)k; off += k;
+    }
+    return 1;
+}
+
+static int read_all(int fd, char *p, size_t n, off_t off) {
+    while (n > 0) {
+        ssize_t k = pread(fd, p, n, off);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return 0;
+        p += k; n -= (size_t)k; off += k;
+    }
+    return 1;
+}
+
+/* Read the record at lsn into r and payload (PAGE_SIZE bytes); 0 at the end of the log or at a torn record */
+static int read_record(const WAL *w, LSN lsn, WalRecord *r, char *payload) {
+    if (!read_all(w->fd, (char *)r, sizeof(WalRecord), file_offset(w, lsn))) return 0;
+    int known = r->type == WAL_PAGE_IMAGE || r->type == WAL_PAGE_DELTA || (r->type == WAL_CHECKPOINT && r->length == (int32_t)sizeof(int64_t));
+    if (!known || r->pageNum < 0 || r->offset < 0 || r->length < 0 ||
+        r->offset > PAGE_SIZE || r->length > PAGE_SIZE - r->offset || r->lsn != lsn + (LSN)sizeof(WalRecord) + r->length) return 0;
+    if (!read_all(w->fd, payload, (size_t)r->length, file_offset(w, lsn) + (off_t)sizeof(WalRecord))) return 0;
+    return record_crc(crc32_update(0, payload, (size_t)r->length), r) == r->crc;
+}
+
+/* Start an empty log at base: header only */
+static int write_header(WAL *w, LSN base) {
+    WalFileHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = WAL_MAGIC;
+    h.base = base;
+    w->base = base;
+    return ftruncate(w->fd, (off_t)sizeof(h)) == 0 && write_all(w->fd, (const char *)&h, sizeof(h), 0) && fdatasync(w->fd) == 0;
+}
+
+/* ------------ Group commit ------------ */
+
+/*
+ * Make the log durable through upTo (clamped to what has been appended).
+ * Called and returns with w->lock held; the leader drops it for the write.
+ */
+static RC flush_locked(WAL *w, LSN upTo) {
+    LSN end = w->bufStart + (LSN)w->used;
+    if (upTo > end) upTo = end;
+    while (w->flushed < upTo && !w->failed) {
+        if (w->flushing) {
+            pthread_cond_wait(&w->cond, &w->lock);
+            continue;
+        }
+        /* lead: take everything appended so far, other threads' records included */
+        char *data = w->buf[w->cur];
+        size_t n = w->used;
+        LSN start = w->bufStart;
+        w->cur ^= 1;
+        w->used = 0;
+        w->bufStart = start + (LSN)n;
+        w->flushing = 1;
+        pthread_mutex_unlock(&w->lock);
+
+        int ok = write_all(w->fd, data, n, file_offset(w, start)) && fdatasync(w->fd) == 0;
+
+        pthread_mutex_lock(&w->lock);
+        w->flushing = 0;
+        w->syncs++;
+        if (ok) w->flushed = start + (LSN)n;
+        else w->failed = 1;
+        pthread_cond_broadcast(&w->cond);
+    }
+    return (w->flushed >= upTo) ? RC_OK : RC_WRITE_FAILED;
+}
+
+/* ------------ Dropping the prefix ------------ */
+
+/* fsync the directory holding fileName, so a rename in it is durable */
+static int sync_dir(const char *fileName) {
+    char *copy = strdup(fileName);
+    int fd = copy ? open(dirname(copy), O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    int ok = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0) close(fd);
+    free(copy);
+    return ok;
+}
+
+/* Write a log starting at `from` with the records [from, upTo) of the current one to fileName */
+static int copy_tail(WAL *w, const char *fileName, LSN from, LSN upTo, int *out) {
+    int fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    char *chunk = malloc(WAL_BUFFER);
+    WalFileHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = WAL_MAGIC;
+    h.base = from;
+    int ok = fd >= 0 && chunk && write_all(fd, (const char *)&h, sizeof(h), 0);
+    for (LSN at = from; ok && at < upTo; ) {
+        size_t n = (upTo - at < WAL_BUFFER) ? (size_t)(upTo - at) : WAL_BUFFER;
+        ok = read_all(w->fd, chunk, n, file_offset(w, at)) && write_all(fd, chunk, n, (off_t)sizeof(h) + (off_t)(at - from));
+        at += (LSN)n;
+    }
+    ok = ok && fdatasync(fd) == 0;
+    free(chunk);
+    if (!ok && fd >= 0) { close(fd); fd = -1; }
+    *out = fd;
+    return ok;
+}
+
+/*
+ * Drop the records before redo if that reclaims at least as much as it
+ * copies. Runs as the flush leader: appends continue into the buffer, but
+ * nothing is written to the log file until the new one is in place.
+ */
+static RC drop_prefix(WAL *w, LSN redo) {
+    pthread_mutex_lock(&w->lock);
+    while (w->flushing) pthread_cond_wait(&w->cond, &w->lock);
+    LSN end = w->flushed;
+    if (w->failed || redo <= w->base || redo > end || redo - w->base < end - redo) {
+        pthread_mutex_unlock(&w->lock);
+        return RC_OK;
+    }
+    w->flushing = 1;
+    pthread_mutex_unlock(&w->lock);
+
+    size_t len = strlen(w->name);
+    char *tmp = malloc(len + 5);
+    int fd = -1, ok = tmp != NULL;
+    if (ok) {
+        memcpy(tmp, w->name, len);
+        memcpy(tmp + len, ".tmp", 5);
+        ok = copy_tail(w, tmp, redo, end, &fd);
+        if (ok && rename(tmp, w->name) != 0) { close(fd); ok = 0; }
+        if (!ok) unlink(tmp);
+        free(tmp);
+    }
+
+    pthread_mutex_lock(&w->lock);
+    if (ok) {
+        close(w->fd);
+        w->fd = fd;
+        w->base = redo;
+    }
+    w->flushing = 0;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    return (ok && sync_dir(w->name)) ? RC_OK : RC_WRITE_FAILED;
+}
+
+/* ------------ Public API ------------ */
+
+RC wal_open(WAL **out, const char *fileName) {
+    if (!out || !fileName) return RC_FILE_HANDLE_NOT_INIT;
+    *out = NULL;
+
+    WAL *w = calloc(1, sizeof(WAL));
+    if (!w) return RC_WRITE_FAILED;
+    w->buf[0] = malloc(WAL_BUFFER);
+    w->buf[1] = malloc(WAL_BUFFER);
+    w->name = strdup(fileName);
+    w->fd = open(fileName, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (!w->buf[0] || !w->buf[1] || !w->name || w->fd < 0) {
+        RC rc = (w->fd < 0) ? RC_FILE_NOT_FOUND : RC_WRITE_FAILED;
+        if (w->fd >= 0) close(w->fd);
+        free(w->buf[0]); free(w->buf[1]); free(w->name); free(w);
+        return rc;
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    /* find the end of the log: the first record that is not complete and intact */
+    WalFileHeader h;
+    LSN end = 0;
+    if (read_all(w->fd, (char *)&h, sizeof(h), 0) && h.magic == WAL_MAGIC) {
+        w->base = end = h.base;
+        WalRecord r;
+        char *payload = malloc(PAGE_SIZE);
+        while (payload && read_record(w, end, &r, payload)) {
+            if (r.type == WAL_CHECKPOINT) memcpy(&w->redo, payload, sizeof(w->redo));
+            end = r.lsn;
+        }
+        if (!payload || ftruncate(w->fd, file_offset(w, end)) != 0) end = -1;
+        free(payload);
+    } else if (!write_header(w, 0)) {
+        end = -1;
+    }
+    if (end < 0) {
+        wal_close(w);
+        return RC_WRITE_FAILED;
+    }
+    w->bufStart = w->flushed = end;
+    *out = w;
+    return RC_OK;
+}
+
+void wal_close(WAL *w) {
+    if (!w) return;
+    close(w->fd);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    free(w->buf[0]);
+    free(w->buf[1]);
+    free(w->name);
+    free(w);
+}
+
+/* Append one record; its checksum covers the payload and the header, LSN included */
+static RC append_record(WAL *w, uint32_t type, int pageNum, int offset, int length, const char *bytes, LSN *lsn) {
+    WalRecord r;
+    memset(&r, 0, sizeof(r));
+    r.type = type;
+    r.pageNum = pageNum;
+    r.offset = offset;
+    r.length = length;
+    uint32_t payloadCrc = crc32_update(0, bytes, (size_t)length);
+    size_t need = sizeof(WalRecord) + (size_t)length;
+
+    pthread_mutex_lock(&w->lock);
+    RC rc = w->failed ? RC_WRITE_FAILED : RC_OK;
+    while (rc == RC_OK && w->used + need > WAL_BUFFER) rc = flush_locked(w, w->bufStart + (LSN)w->used);
+    if (rc == RC_OK) {
+        char *at = w->buf[w->cur] + w->used;
+        r.lsn = w->bufStart + (LSN)(w->used + need);
+        r.crc = record_crc(payloadCrc, &r);
+        memcpy(at, &r, sizeof(r));
+        memcpy(at + sizeof(r), bytes, (size_t)length);
+        w->used += need;
+        w->records++;
+        if (lsn) *lsn = r.lsn;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return rc;
+}
+
+RC wal_append(WAL *w, int pageNum, int offset, int length, const char *bytes, LSN *lsn) {
+    if (!w || pageNum < 0 || offset < 0 || length < 0 || offset > PAGE_SIZE || length > PAGE_SIZE - offset || (length > 0 && !bytes))
+        return RC_FILE_HANDLE_NOT_INIT;
+    return append_record(w, (offset == 0 && length == PAGE_SIZE) ? WAL_PAGE_IMAGE : WAL_PAGE_DELTA, pageNum, offset, length, bytes, lsn);
+}
+
+RC wal_checkpoint(WAL *w, LSN redo, LSN *lsn) {
+    if (!w || redo < 0) return RC_FILE_HANDLE_NOT_INIT;
+    int64_t payload = redo;
+    LSN at;
+    RC rc = append_record(w, WAL_CHECKPOINT, 0, 0, (int)sizeof(payload), (const char *)&payload, &at);
+    if (rc == RC_OK) rc = wal_flush(w, at);
+    if (rc == RC_OK) {
+        pthread_mutex_lock(&w->lock);
+        w->redo = redo;   /* may move back: a later checkpoint can skip a page with older changes */
+        pthread_mutex_unlock(&w->lock);
+        if (lsn) *lsn = at;
+        rc = drop_prefix(w, redo);
+    }
+    return rc;
+}
+
+RC wal_flush(WAL *w, LSN upTo) {
+    if (!w) return RC_FILE_HANDLE_NOT_INIT;
+    pthread_mutex_lock(&w->lock);
+    RC rc = flush_locked(w, upTo);
+    pthread_mutex_unlock(&w->lock);
+    return rc;
+}
+
+LSN wal_endLSN(WAL *w) {
+    if (!w) return 0;
+    pthread_mutex_lock(&w->lock);
+    LSN l = w->bufStart + (LSN)w->used;
+    pthread_mutex_unlock(&w->lock);
+    return l;
+}
+
+LSN wal_flushedLSN(WAL *w) {
+    if (!w) return 0;
+    pthread_mutex_lock(&w->lock);
+    LSN l = w->flushed;
+    pthread_mutex_unlock(&w->lock);
+    return l;
+}
+
+/* Redo, in log order, from the last checkpoint on; changes beyond the end of the page file extend it */
+RC wal_replay(WAL *w, SM_FileHandle *fh, int *applied) {
+    if (!w || !fh) return RC_FILE_HANDLE_NOT_INIT;
+    RC rc = wal_flush(w, LSN_MAX);
+    char *payload = malloc(PAGE_SIZE), *page = malloc(PAGE_SIZE);
+    int n = 0;
+    if (!payload || !page) rc = RC_WRITE_FAILED;
+
+    WalRecord r;
+    for (LSN at = (w->redo > w->base) ? w->redo : w->base; rc == RC_OK && at < w->flushed; at = r.lsn) {
+        if (!read_record(w, at, &r, payload)) { rc = RC_READ_NON_EXISTING_PAGE; break; }
+        if (r.type == WAL_CHECKPOINT) continue;
+        rc = ensureCapacity(r.pageNum + 1, fh);
+        if (rc == RC_OK && r.type == WAL_PAGE_DELTA) rc = readBlock(r.pageNum, fh, page);
+        if (rc == RC_OK) {
+            memcpy(page + r.offset, payload, (size_t)r.length);
+            rc = writeBlock(r.pageNum, fh, page);
+        }
+        n++;
+    }
+    if (rc == RC_OK && n > 0) rc = syncFile(fh);
+    if (applied) *applied = n;
+    free(payload);
+    free(page);
+    return rc;
+}
+
+RC wal_reset(WAL *w) {
+    if (!w) return RC_FILE_HANDLE_NOT_INIT;
+    pthread_mutex_lock(&w->lock);
+    while (w->flushing) pthread_cond_wait(&w->cond, &w->lock);
+    LSN end = w->bufStart + (LSN)w->used;
+    RC rc = RC_OK;
+    if (end != w->base) {
+        if (write_header(w, end)) {
+            w->used = 0;
+            w->bufStart = w->flushed = end;
+        } else {
+            w->failed = 1;
+            rc = RC_WRITE_FAILED;
+        }
+    }
+    pthread_mutex_unlock(&w->lock);
+    return rc;
+}
+
+void wal_counters(WAL *w, long long *records, long long *syncs) {
+    if (!w) return;
+    pthread_mutex_lock(&w->lock);
+    if (records) *records = w->records;
+    if (syncs) *syncs = w->syncs;
+    pthread_mutex_unlock(&w->lock);
+}
@@ -0,0 +1,62 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include <limits.h>
+#include "storage_mgr.h"
+
+/*
+ * WAL — a page-level write-ahead log for one page file.
+ * ------------------------------------------------------------
+ * Records describe a page change physically: a full page image, or a delta
+ * (bytes [offset, offset+length) of the page). They are appended to an
+ * in-memory buffer and written to the log file sequentially. Every record
+ * gets an LSN, the log position just past its end, so "durable through LSN
+ * x" means every record with an LSN <= x survives a crash.
+ *
+ * wal_flush is a group commit: one caller writes everything appended so far
+ * with one write and one fdatasync, while callers arriving meanwhile wait
+ * for it and, if their records came later, for the next one, which again
+ * takes everything that accumulated. Many transactions committing at once
+ * therefore share a few syncs.
+ *
+ * Recovery is redo only: wal_replay applies the records to the page file,
+ * in log order, starting at the redo LSN of the last checkpoint record
+ * (wal_checkpoint), before which every change is known to be in the file;
+ * the checkpoint also drops the records before it, so the log does not grow
+ * without bound.
+ * A torn tail (a record cut short by a crash) is recognized by its checksum
+ * and dropped when the log is opened.
+ */
+
+typedef long long LSN;
+#define LSN_MAX LLONG_MAX
+
+typedef struct WAL WAL;
+
+/* open or create the log; appends continue after its last complete record */
+RC   wal_open (WAL **w, const char *fileName);
+void wal_close (WAL *w);
+
+/* log bytes [offset, offset+length) of page pageNum (the whole page is an image record); *lsn is the record's LSN */
+RC   wal_append (WAL *w, int pageNum, int offset, int length, const char *bytes, LSN *lsn);
+/* block until the log is durable through upTo (LSN_MAX: everything appended so far) */
+RC   wal_flush (WAL *w, LSN upTo);
+LSN  wal_flushedLSN (WAL *w);
+/* LSN the next record will start at */
+LSN  wal_endLSN (WAL *w);
+/*
+ * durably record a checkpoint: every change logged before redo is in the page
+ * file. Drops the records before redo once they take at least as much room as
+ * the rest of the log, by writing the rest to a new file renamed over this one.
+ */
+RC   wal_checkpoint (WAL *w, LSN redo, LSN *lsn);
+
+/* apply the records since the last checkpoint to the page file and sync it; *applied (optional) counts them */
+RC   wal_replay (WAL *w, SM_FileHandle *fh, int *applied);
+/* empty the log once the page file holds all its changes durably; no appends may run concurrently */
+RC   wal_reset (WAL *w);
+
+/* records appended and syncs issued since the log was opened */
+void wal_counters (WAL *w, long long *records, long long *syncs);
+
+#endif